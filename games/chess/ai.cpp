@@ -7,6 +7,8 @@
 #include "search.hpp"
 
 #include <cmath>
+#include <fstream>
+#include <sstream>
 
 namespace cpp_client
 {
@@ -32,6 +34,22 @@ void AI::start()
 {
     // This is a good place to initialize any variables
     srand(time(NULL));
+    tables_aged = false;
+    for (const char* key : ENGINE_SETTING_KEYS)
+      if (!get_setting(key).empty())
+        settings.set(key, get_setting(key));
+    if (!settings.book.empty() && !book.open(settings.book))
+      std::cerr << "Could not open opening book " << settings.book << std::endl;
+
+    // Three-piece endings are cheap enough to build each game, but a cache skips even that
+    if (settings.bitbases.empty() || !BITBASES.load(settings.bitbases))
+    {
+      BITBASES.generate();
+      if (!settings.bitbases.empty() && !BITBASES.save(settings.bitbases))
+        std::cerr << "Could not write bitbase cache " << settings.bitbases << std::endl;
+    }
+    if (settings.probe)
+      tables.tablebases = &tablebases;
 }
 
 /// <summary>
@@ -40,6 +58,13 @@ void AI::start()
 void AI::game_updated()
 {
     // If a function you call triggers an update this will be called before it returns.
+
+    // Once the opponent has moved, check whether they played the reply being pondered
+    if (game->current_player == player && !game->moves.empty())
+    {
+        const Move& last = game->moves.back();
+        ponderer.resolve(last->from_file[0], last->from_rank, last->to_file[0], last->to_rank, last->promotion);
+    }
 }
 
 /// <summary>
@@ -50,6 +75,7 @@ void AI::game_updated()
 void AI::ended(bool won, const std::string& reason)
 {
     // You can do any cleanup of your AI here.  The program ends when this function returns.
+    ponderer.stop();
 }
 
 /// <summary>
@@ -58,27 +84,73 @@ void AI::ended(bool won, const std::string& reason)
 /// <returns>Represents if you want to end your turn. True means end your turn, False means to keep your turn going and re-call this function.</returns>
 bool AI::run_turn()
 {
-    std::cout << "Time Remaining: " << player->time_remaining << " ns" << std::endl;
+    State state(game);
 
-    chess::Piece p = player->pieces[rand() % player->pieces.size()];
+    MyMove move;
+    bool ponder_hit = false;
 
-    State state(game);
+    // A book move costs no clock; it is only played if legal here
+    bool book_hit = book.is_open() && book.choose(state, settings.book_best, move);
 
-    state.print();
+    if (!book_hit && ponderer.hit())
+    {
+      // The opponent played the reply we pondered, so keep that search
+      move = ponderer.finish(player->time_remaining, game->current_turn, game->max_turns);
 
-    auto move = tliddlmm(game, state, 20, 1);
+      // The pondered line was built without the framework; make sure its move is still legal here
+      for (auto action : state.ACTIONS())
+        if (action.hash() == move.hash())
+          ponder_hit = true;
+    }
+    ponderer.stop();
 
-    state.RESULT(move).print();
+    if (!book_hit && !ponder_hit)
+    {
+      if (!tables_aged)
+        tables.new_search();
+      timer.start(player->time_remaining, game->current_turn, game->max_turns);
+      move = tliddlmm(state, tables, eval_cache, timer, settings.depth, settings.quiescence);
+    }
+
+    // One line per turn; the same as JSON when --aiSettings stats=<file> is given
+    std::ostringstream note;
+    note << "eval " << std::round(eval_cache.hit_rate() * 100) << "% clock "
+         << player->time_remaining / 1e9 << "s";
+    if (book_hit)
+      note << " book";
+    else if (ponder_hit)
+      note << " ponder hit";
+    else
+      note << " soft " << timer.soft() << "s hard " << timer.hard() << "s";
+    // A book move has no iterations of its own
+    const std::vector<IterationStats> none;
+    const std::vector<IterationStats>& iterations = (book_hit ? none : tables.iterations);
+    std::cout << stats_line(game->current_turn, iterations, note.str()) << std::endl;
+    if (!settings.stats.empty())
+    {
+      std::ofstream out(settings.stats, std::ios::app);
+      out << stats_json(game->current_turn, iterations, note.str()) << std::endl;
+    }
 
     for (auto piece : player->pieces)
     {
       if (piece->rank == move.rank && piece->file[0] == move.file)
       {
-        piece->move(std::string(1, move.file2), move.rank2, lengthen((move.promotion)));
+        piece->move(std::string(1, move.file2), move.rank2, PIECE_NAMES[move.promotion]);
         break;
       }
     }
 
+    // Think on the opponent's time, starting from the reply our principal variation expects
+    if (settings.ponder)
+    {
+      std::vector<uint16_t> pv = tables.principal_variation();
+      uint16_t reply = (!book_hit && pv.size() > 1 && pv[0] == move.id() ? pv[1] : 0);
+      tables.new_search();
+      ponderer.start(state.RESULT(move), tables, eval_cache, settings.depth, settings.quiescence, reply);
+    }
+    tables_aged = settings.ponder;
+
     return true; // to signify we are done with our turn.
 }
 
@@ -13,6 +13,14 @@
 
 // You can add additional #includes here
 #include "custom_board.hpp"
+#include "eval_cache.hpp"
+#include "time_manager.hpp"
+#include "search.hpp"
+#include "ponder.hpp"
+#include "book.hpp"
+#include "tablebase.hpp"
+#include "bitbase.hpp"
+#include "engine_settings.hpp"
 #include <limits>
 
 namespace cpp_client
@@ -39,6 +47,30 @@ public:
 
     // You can add additional class variables here.
 
+    // Static evaluations shared by every search this game
+    EvalCache eval_cache;
+
+    // Transposition, history, killer and continuation tables, kept warm across turns
+    SearchTables tables;
+
+    // Allocates the search time for each turn
+    TimeManager timer;
+
+    // Searches on the opponent's time between our turns
+    Ponderer ponderer;
+
+    // Whether tables were aged for the next search when pondering started, so a ponder miss does not age them twice
+    bool tables_aged;
+
+    // The --aiSettings this AI understands, read once in start()
+    EngineSettings settings;
+
+    // Opening book consulted before searching; set with --aiSettings book=<file>
+    OpeningBook book;
+
+    // Endgame tables probed by the search, backed by the built-in BITBASES
+    Tablebases tablebases;
+
     /// <summary>
     /// This returns your AI's name to the game server.
     /// Replace the string name.
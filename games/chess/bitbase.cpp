@@ -0,0 +1,263 @@
+//////////////////////////////////////////////////////////////////////
+/// @file bitbase.cpp
+/// @author Shawn McCormick CS5400
+/// @brief Win/draw bitbases for king and pawn, rook or queen against king
+//////////////////////////////////////////////////////////////////////
+
+#include "bitbase.hpp"
+#include "bitboard.hpp"
+
+#include <algorithm>
+#include <cstring>
+#include <fstream>
+#include <thread>
+
+namespace cpp_client
+{
+
+namespace chess
+{
+
+Bitbases BITBASES;
+
+// Identifies a file written by Bitbases::save()
+const char BITBASE_MAGIC[8] = {'P', 'P', 'B', 'B', 'K', 'X', 'K', '1'};
+
+// What retrograde analysis knows of a position
+enum Result : uint8_t { INVALID, UNKNOWN, DRAWN, WON };
+
+// The strong side is white; weak is black
+//      stm: 0 when the strong side is to move
+struct Position {
+    int stm;
+    int strong_king;
+    int weak_king;
+    int piece;
+};
+
+static int index_of(int stm, int strong_king, int weak_king, int piece)
+{
+  return stm | strong_king << 1 | weak_king << 7 | piece << 13;
+}
+
+static Position position_of(int index)
+{
+  return Position{index & 1, (index >> 1) & 63, (index >> 7) & 63, index >> 13};
+}
+
+// Tiles the strong side's extra piece attacks, with the given tiles occupied
+static U64 piece_attacks(Ending ending, int sq, U64 occupied)
+{
+  if (ending == KPK)
+    return PAWN_ATTACKS[0][sq];
+  U64 attacks = 0;
+  // Straight directions come first in RAY_STEPS, diagonal last
+  for (int dir = 0; dir < (ending == KQK ? 8 : 4); dir++)
+    attacks |= ray_attacks(dir, sq, occupied);
+  return attacks;
+}
+
+// Whether an index is a legal position: three distinct tiles, kings apart,
+// no pawn on the back ranks, and the side not to move not in check
+static bool valid(Ending ending, const Position& p)
+{
+  if (p.strong_king == p.weak_king || p.piece == p.strong_king || p.piece == p.weak_king)
+    return false;
+  if (KING_ATTACKS[p.strong_king] >> p.weak_king & 1)
+    return false;
+  if (ending == KPK && (p.piece < 8 || p.piece >= 56))
+    return false;
+  U64 occupied = 1ULL << p.strong_king | 1ULL << p.weak_king;
+  return p.stm == 1 || !(piece_attacks(ending, p.piece, occupied) >> p.weak_king & 1);
+}
+
+// Legal moves of the weak king, which may capture the piece if it is undefended
+static U64 weak_moves(Ending ending, const Position& p)
+{
+  U64 occupied = 1ULL << p.strong_king | 1ULL << p.piece; // Without the weak king, which is moving
+  U64 guarded = KING_ATTACKS[p.strong_king] | piece_attacks(ending, p.piece, occupied);
+  return KING_ATTACKS[p.weak_king] & ~guarded;
+}
+
+void Bitbases::generate(Ending ending, int threads)
+{
+  std::vector<uint8_t> results(BITBASE_SIZE, INVALID);
+  std::vector<uint8_t> remaining(BITBASE_SIZE, 0); // Weak side moves not yet known to lose
+
+  // Classify every index from its own moves; each thread takes a range
+  auto classify = [&](int first, int last)
+  {
+    for (int index = first; index < last; index++)
+    {
+      Position p = position_of(index);
+      if (!valid(ending, p))
+        continue;
+      results[index] = UNKNOWN;
+
+      if (p.stm == 1)
+      {
+        U64 moves = weak_moves(ending, p);
+        remaining[index] = popcount(moves);
+        if (moves == 0)
+        {
+          // Checkmate wins; stalemate is a draw, as State::stalemate() would find
+          U64 occupied = 1ULL << p.strong_king | 1ULL << p.weak_king;
+          bool check = piece_attacks(ending, p.piece, occupied) >> p.weak_king & 1;
+          results[index] = (check ? WON : DRAWN);
+        }
+      }
+      else if (ending == KPK && p.piece >= 48)
+      {
+        // Promoting wins if the rook or queen ending it enters does
+        int to = p.piece + 8;
+        if (to != p.strong_king && to != p.weak_king
+            && (win(KQK, index_of(1, p.strong_king, p.weak_king, to)) || win(KRK, index_of(1, p.strong_king, p.weak_king, to))))
+          results[index] = WON;
+      }
+    }
+  };
+
+  if (threads <= 0)
+    threads = std::max(1u, std::thread::hardware_concurrency());
+  std::vector<std::thread> workers;
+  for (int t = 0; t < threads; t++)
+    workers.push_back(std::thread(classify, BITBASE_SIZE / threads * t, (t == threads - 1 ? BITBASE_SIZE : BITBASE_SIZE / threads * (t + 1))));
+  for (std::thread& worker : workers)
+    worker.join();
+
+  std::vector<int> won;
+  for (int index = 0; index < BITBASE_SIZE; index++)
+    if (results[index] == WON)
+      won.push_back(index);
+
+  // Un-move from each won position into the positions that could have led to it
+  while (!won.empty())
+  {
+    Position p = position_of(won.back());
+    won.pop_back();
+    U64 occupied = 1ULL << p.strong_king | 1ULL << p.weak_king | 1ULL << p.piece;
+
+    if (p.stm == 1)
+    {
+      // The strong side just moved here, so the position before is won
+      std::vector<Position> before;
+      U64 king_from = KING_ATTACKS[p.strong_king] & ~occupied;
+      for (; king_from; king_from &= king_from - 1)
+        before.push_back(Position{0, lsb(king_from), p.weak_king, p.piece});
+
+      U64 piece_from = 0;
+      if (ending == KPK)
+      {
+        // One step back, or two from the fourth rank through an empty third
+        if (p.piece >= 16 && !(occupied >> (p.piece - 8) & 1))
+        {
+          piece_from |= 1ULL << (p.piece - 8);
+          if (p.piece / 8 == 3 && !(occupied >> (p.piece - 16) & 1))
+            piece_from |= 1ULL << (p.piece - 16);
+        }
+      }
+      else
+        piece_from = piece_attacks(ending, p.piece, occupied) & ~occupied;
+      for (; piece_from; piece_from &= piece_from - 1)
+        before.push_back(Position{0, p.strong_king, p.weak_king, lsb(piece_from)});
+
+      for (const Position& q : before)
+      {
+        int index = index_of(q.stm, q.strong_king, q.weak_king, q.piece);
+        if (results[index] == UNKNOWN)
+        {
+          results[index] = WON;
+          won.push_back(index);
+        }
+      }
+    }
+    else
+    {
+      // The weak king just moved here; the position before is won once every move from it is
+      U64 king_from = KING_ATTACKS[p.weak_king] & ~occupied & ~KING_ATTACKS[p.strong_king];
+      for (; king_from; king_from &= king_from - 1)
+      {
+        int index = index_of(1, p.strong_king, lsb(king_from), p.piece);
+        if (results[index] == UNKNOWN && --remaining[index] == 0)
+        {
+          results[index] = WON;
+          won.push_back(index);
+        }
+      }
+    }
+  }
+
+  wins[ending].assign(BITBASE_SIZE / 64, 0);
+  for (int index = 0; index < BITBASE_SIZE; index++)
+    if (results[index] == WON)
+      wins[ending][index >> 6] |= 1ULL << (index & 63);
+}
+
+void Bitbases::generate(int threads)
+{
+  generate(KQK, threads);
+  generate(KRK, threads);
+  generate(KPK, threads);
+}
+
+bool Bitbases::load(const std::string& path)
+{
+  std::ifstream in(path, std::ios::binary);
+  char magic[sizeof(BITBASE_MAGIC)];
+  if (!in.read(magic, sizeof(magic)) || std::memcmp(magic, BITBASE_MAGIC, sizeof(magic)) != 0)
+    return false;
+
+  std::vector<U64> loaded[ENDINGS];
+  for (auto& ending : loaded)
+  {
+    ending.resize(BITBASE_SIZE / 64);
+    if (!in.read(reinterpret_cast<char*>(ending.data()), ending.size() * sizeof(U64)))
+      return false;
+  }
+  for (int ending = 0; ending < ENDINGS; ending++)
+    wins[ending].swap(loaded[ending]);
+  return true;
+}
+
+bool Bitbases::save(const std::string& path) const
+{
+  if (!ready())
+    return false;
+  std::ofstream out(path, std::ios::binary);
+  out.write(BITBASE_MAGIC, sizeof(BITBASE_MAGIC));
+  for (const auto& ending : wins)
+    out.write(reinterpret_cast<const char*>(ending.data()), ending.size() * sizeof(U64));
+  return static_cast<bool>(out);
+}
+
+bool Bitbases::probe(const State& state, WDL& result) const
+{
+  if (!ready() || state.piece_count() != 3)
+    return false;
+
+  // The strong side owns the piece that is not a king
+  for (int strong = 0; strong < 2; strong++)
+  {
+    for (int ending = 0; ending < ENDINGS; ending++)
+    {
+      static const PieceType EXTRA[ENDINGS] = {PAWN, ROOK, QUEEN};
+      U64 piece = state.pieces_of(strong, EXTRA[ending]);
+      if (!piece)
+        continue;
+
+      // Flip black's positions so the strong side plays up the board as white
+      int flip = (strong ? 56 : 0);
+      int strong_king = lsb(state.pieces_of(strong, KING)) ^ flip;
+      int weak_king = lsb(state.pieces_of(!strong, KING)) ^ flip;
+      int stm = (state.player_to_move() != strong);
+      bool won = win(static_cast<Ending>(ending), index_of(stm, strong_king, weak_king, lsb(piece) ^ flip));
+      result = (!won ? WDL_DRAW : stm == 0 ? WDL_WIN : WDL_LOSS);
+      return true;
+    }
+  }
+  return false;
+}
+
+}
+
+}
@@ -0,0 +1,83 @@
+//////////////////////////////////////////////////////////////////////
+/// @file bitbase.hpp
+/// @author Shawn McCormick CS5400
+/// @brief Win/draw bitbases for king and pawn, rook or queen against king
+//////////////////////////////////////////////////////////////////////
+
+#ifndef BITBASE_HPP
+#define BITBASE_HPP
+
+#include "custom_board.hpp"
+#include "tablebase.hpp"
+
+#include <string>
+#include <vector>
+
+typedef unsigned long long U64;
+
+namespace cpp_client
+{
+
+namespace chess
+{
+
+// The endings covered, by the strong side's extra piece
+enum Ending { KPK, KRK, KQK, ENDINGS };
+
+// Positions in each ending: side to move, strong king, weak king and extra piece
+//      Index bits: strong side to move = 0 | strong king << 1 | weak king << 7 | piece << 13
+const int BITBASE_SIZE = 2 * 64 * 64 * 64;
+
+//////////////////////////////////////////////////////////////////////
+/// @class Bitbases
+/// @brief One bit per position: whether the side with the extra piece wins
+///
+/// generate() builds the three endings by retrograde analysis: checkmates
+/// and the pawn's promotions into the rook and queen endings are marked
+/// won, then each won position un-moves into its predecessors. A position
+/// with the strong side to move is won if any move wins. With the weak
+/// side to move it is won once all of its moves do. Whatever is left when
+/// nothing changes is a draw.
+//////////////////////////////////////////////////////////////////////
+class Bitbases {
+  private:
+    std::vector<U64> wins[ENDINGS]; // A bit per index; empty until generated or loaded
+
+    // Build one ending; KPK needs KRK and KQK first for its promotions
+    void generate(Ending ending, int threads);
+
+  public:
+    // Build every ending
+    // Parameters:
+    //      int threads: Threads to share the classification between; 0 for one per core
+    void generate(int threads = 0);
+
+    // Read the endings from a file written by save()
+    // Returns false, leaving the bitbases alone, if the file is missing or malformed
+    bool load(const std::string& path);
+
+    // Write the endings to a file
+    // Returns false if the file cannot be written
+    bool save(const std::string& path) const;
+
+    // Whether the endings are built
+    bool ready() const { return !wins[KQK].empty(); }
+
+    // Whether the side with the extra piece wins a position, by index
+    bool win(Ending ending, int index) const { return (wins[ending][index >> 6] >> (index & 63)) & 1; }
+
+    // Result of a position for the player to move
+    // Returns false if the bitbases are not ready or do not cover the position
+    bool probe(const State& state, WDL& result) const;
+};
+
+// The bitbases the evaluation and tablebase probes consult; empty until the AI builds them
+//      The program owns this, not any one search: it is filled once, by AI::start or a
+//      tool's main, before searching begins, and is only read after that, so threads share it
+extern Bitbases BITBASES;
+
+}
+
+}
+
+#endif
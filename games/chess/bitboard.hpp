@@ -0,0 +1,225 @@
+//////////////////////////////////////////////////////////////////////
+/// @file bitboard.hpp
+/// @author Shawn McCormick CS5400
+/// @brief Attack and line lookup tables for 64-bit bitboards
+///
+/// Tiles are numbered file + 8 * rank from a1 = 0, as in MyMove::id().
+/// Every table is built by constexpr functions, so it is part of the
+/// binary's read-only data and costs nothing at static initialization.
+//////////////////////////////////////////////////////////////////////
+
+#ifndef BITBOARD_HPP
+#define BITBOARD_HPP
+
+#ifdef _MSC_VER
+#include <intrin.h>
+#endif
+
+typedef unsigned long long U64;
+
+namespace cpp_client
+{
+
+namespace chess
+{
+
+// Lowest set tile of a non-empty bitboard
+inline int lsb(U64 b)
+{
+#ifdef _MSC_VER
+  unsigned long index;
+  _BitScanForward64(&index, b);
+  return index;
+#else
+  return __builtin_ctzll(b);
+#endif
+}
+
+// Highest set tile of a non-empty bitboard
+inline int msb(U64 b)
+{
+#ifdef _MSC_VER
+  unsigned long index;
+  _BitScanReverse64(&index, b);
+  return index;
+#else
+  return 63 ^ __builtin_clzll(b);
+#endif
+}
+
+// Number of set tiles
+inline int popcount(U64 b)
+{
+#ifdef _MSC_VER
+  return static_cast<int>(__popcnt64(b));
+#else
+  return __builtin_popcountll(b);
+#endif
+}
+
+// Ray directions as {file, rank}, in opposite pairs so direction ^ 1 is the reverse:
+//      N, S, E, W, NE, SW, NW, SE
+// The first four are straight, the rest diagonal
+constexpr int RAY_STEPS[8][2] = {{0, 1}, {0, -1}, {1, 0}, {-1, 0}, {1, 1}, {-1, -1}, {-1, 1}, {1, -1}};
+
+// Whether a direction moves toward higher tile numbers, so its nearest blocker is the lowest set tile
+constexpr bool RAY_ASCENDING[8] = {true, false, true, false, true, false, true, false};
+
+// Compile-time table construction
+namespace tables
+{
+    // A pack of the integers [0, N), built by halves to keep template recursion shallow
+    template <int... Is> struct Indices {};
+
+    template <class A, class B> struct Concat;
+    template <int... A, int... B>
+    struct Concat<Indices<A...>, Indices<B...>> { typedef Indices<A..., (sizeof...(A) + B)...> type; };
+
+    template <int N>
+    struct MakeIndices { typedef typename Concat<typename MakeIndices<N / 2>::type, typename MakeIndices<N - N / 2>::type>::type type; };
+    template <> struct MakeIndices<0> { typedef Indices<> type; };
+    template <> struct MakeIndices<1> { typedef Indices<0> type; };
+
+    constexpr bool on_board(int file, int rank)
+    {
+      return 0 <= file && file < 8 && 0 <= rank && rank < 8;
+    }
+
+    // The tile at (file, rank) as a bitboard, or empty if it is off the board
+    constexpr U64 tile(int file, int rank)
+    {
+      return on_board(file, rank) ? 1ULL << (file + 8 * rank) : 0;
+    }
+
+    // The tile one step from a tile, or empty if it is off the board
+    constexpr U64 step(int sq, int df, int dr)
+    {
+      return tile(sq % 8 + df, sq / 8 + dr);
+    }
+
+    constexpr U64 knight(int sq)
+    {
+      return step(sq, 2, 1) | step(sq, 2, -1) | step(sq, -2, 1) | step(sq, -2, -1)
+           | step(sq, 1, 2) | step(sq, 1, -2) | step(sq, -1, 2) | step(sq, -1, -2);
+    }
+
+    constexpr U64 king(int sq)
+    {
+      return step(sq, -1, -1) | step(sq, -1, 0) | step(sq, -1, 1) | step(sq, 0, -1)
+           | step(sq, 0, 1) | step(sq, 1, -1) | step(sq, 1, 0) | step(sq, 1, 1);
+    }
+
+    // Tiles a pawn of owner (0 white, 1 black) on sq attacks
+    constexpr U64 pawn(int owner, int sq)
+    {
+      return step(sq, -1, owner ? -1 : 1) | step(sq, 1, owner ? -1 : 1);
+    }
+
+    // Every tile from (file, rank), exclusive, to the edge of the board in one direction
+    constexpr U64 ray_from(int file, int rank, int df, int dr)
+    {
+      return on_board(file + df, rank + dr) ? tile(file + df, rank + dr) | ray_from(file + df, rank + dr, df, dr) : 0;
+    }
+
+    constexpr U64 ray(int dir, int sq)
+    {
+      return ray_from(sq % 8, sq / 8, RAY_STEPS[dir][0], RAY_STEPS[dir][1]);
+    }
+
+    // Tiles strictly between a and b if b lies in direction dir from a
+    constexpr U64 between_in(int dir, int a, int b)
+    {
+      return ((ray(dir, a) >> b) & 1) ? ray(dir, a) & ray(dir ^ 1, b) : 0;
+    }
+
+    constexpr U64 between(int a, int b)
+    {
+      return between_in(0, a, b) | between_in(1, a, b) | between_in(2, a, b) | between_in(3, a, b)
+           | between_in(4, a, b) | between_in(5, a, b) | between_in(6, a, b) | between_in(7, a, b);
+    }
+
+    // The whole line through a and b if b lies in direction dir from a
+    constexpr U64 line_in(int dir, int a, int b)
+    {
+      return ((ray(dir, a) >> b) & 1) ? ray(dir, a) | ray(dir ^ 1, a) | (1ULL << a) : 0;
+    }
+
+    constexpr U64 line(int a, int b)
+    {
+      return line_in(0, a, b) | line_in(1, a, b) | line_in(2, a, b) | line_in(3, a, b)
+           | line_in(4, a, b) | line_in(5, a, b) | line_in(6, a, b) | line_in(7, a, b);
+    }
+}
+
+// A bitboard for every tile
+struct TileTable {
+    U64 bb[64];
+    U64 operator[](int sq) const { return bb[sq]; }
+};
+
+// A bitboard for every pair of tiles, indexed [a * 64 + b]
+struct PairTable {
+    U64 bb[64 * 64];
+    U64 operator()(int a, int b) const { return bb[a * 64 + b]; }
+};
+
+namespace tables
+{
+    template <int... Is>
+    constexpr TileTable knight_table(Indices<Is...>) { return TileTable{{knight(Is)...}}; }
+
+    template <int... Is>
+    constexpr TileTable king_table(Indices<Is...>) { return TileTable{{king(Is)...}}; }
+
+    template <int Owner, int... Is>
+    constexpr TileTable pawn_table(Indices<Is...>) { return TileTable{{pawn(Owner, Is)...}}; }
+
+    template <int Dir, int... Is>
+    constexpr TileTable ray_table(Indices<Is...>) { return TileTable{{ray(Dir, Is)...}}; }
+
+    template <int... Is>
+    constexpr PairTable between_table(Indices<Is...>) { return PairTable{{between(Is / 64, Is % 64)...}}; }
+
+    template <int... Is>
+    constexpr PairTable line_table(Indices<Is...>) { return PairTable{{line(Is / 64, Is % 64)...}}; }
+}
+
+// Tiles a knight or king on a tile attacks
+constexpr TileTable KNIGHT_ATTACKS = tables::knight_table(tables::MakeIndices<64>::type());
+constexpr TileTable KING_ATTACKS = tables::king_table(tables::MakeIndices<64>::type());
+
+// PAWN_ATTACKS[owner][sq]: Tiles a pawn of owner's on sq attacks
+constexpr TileTable PAWN_ATTACKS[2] = {tables::pawn_table<0>(tables::MakeIndices<64>::type()),
+                                       tables::pawn_table<1>(tables::MakeIndices<64>::type())};
+
+// RAYS[dir][sq]: Tiles from sq, exclusive, to the edge of the board in direction dir of RAY_STEPS
+constexpr TileTable RAYS[8] = {tables::ray_table<0>(tables::MakeIndices<64>::type()),
+                               tables::ray_table<1>(tables::MakeIndices<64>::type()),
+                               tables::ray_table<2>(tables::MakeIndices<64>::type()),
+                               tables::ray_table<3>(tables::MakeIndices<64>::type()),
+                               tables::ray_table<4>(tables::MakeIndices<64>::type()),
+                               tables::ray_table<5>(tables::MakeIndices<64>::type()),
+                               tables::ray_table<6>(tables::MakeIndices<64>::type()),
+                               tables::ray_table<7>(tables::MakeIndices<64>::type())};
+
+// BETWEEN(a, b): Tiles strictly between a and b on a shared rank, file or diagonal, else empty
+constexpr PairTable BETWEEN = tables::between_table(tables::MakeIndices<64 * 64>::type());
+
+// LINE(a, b): The whole rank, file or diagonal through a and b, else empty; used to keep pinned pieces on their pin
+constexpr PairTable LINE = tables::line_table(tables::MakeIndices<64 * 64>::type());
+
+// Tiles a slider on sq reaches in direction dir, stopping at and including the first occupied tile
+inline U64 ray_attacks(int dir, int sq, U64 occupied)
+{
+  U64 attacks = RAYS[dir][sq];
+  U64 blockers = attacks & occupied;
+  if (blockers)
+    attacks ^= RAYS[dir][RAY_ASCENDING[dir] ? lsb(blockers) : msb(blockers)];
+  return attacks;
+}
+
+}
+
+}
+
+#endif
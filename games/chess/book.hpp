@@ -0,0 +1,100 @@
+//////////////////////////////////////////////////////////////////////
+/// @file book.hpp
+/// @author Shawn McCormick CS5400
+/// @brief Polyglot opening book reader
+//////////////////////////////////////////////////////////////////////
+
+#ifndef BOOK_HPP
+#define BOOK_HPP
+
+#include "custom_board.hpp"
+#include "mapped_file.hpp"
+
+#include <cstddef>
+#include <cstdint>
+#include <string>
+#include <vector>
+
+typedef unsigned long long U64;
+
+namespace cpp_client
+{
+
+namespace chess
+{
+
+// Random keys in Polyglot's layout:
+//      [64 * kind + tile] for each piece, where kind is 2 * PieceType + (owner is white)
+//      [768 + side] for each castling right, in CASTLE_RIGHTS bit order
+//      [772 + file] for an en passant capture on that file
+//      [780] when white is to move
+const int POLYGLOT_KEYS = 781;
+extern const U64 POLYGLOT_RANDOM[POLYGLOT_KEYS];
+
+// Polyglot hash of the position; unlike State::hash() it is the same in every build
+U64 polyglot_key(const State& state);
+
+// A book move as stored in the file
+//      move is Polyglot's: to tile | from tile << 6 | promotion << 12, with
+//      promotion {0 none, 1 knight, 2 bishop, 3 rook, 4 queen} and castling
+//      written as the king capturing its own rook
+struct BookEntry {
+    U64 key;
+    uint16_t move;
+    uint16_t weight;
+    uint32_t learn;
+};
+
+// Size of an entry in the file: big-endian key, move, weight and learn
+const std::size_t BOOK_ENTRY_SIZE = 16;
+
+// A move in BookEntry's encoding
+uint16_t polyglot_move(const MyMove& move);
+
+// Write an entry to the BOOK_ENTRY_SIZE bytes at out, in the file's byte order
+void encode_book_entry(const BookEntry& entry, unsigned char* out);
+
+//////////////////////////////////////////////////////////////////////
+/// @class OpeningBook
+/// @brief A read-only Polyglot .bin book, memory mapped
+///
+/// The entries are sorted by key, so a position's moves are found by
+/// binary search over the mapping without reading the file into memory.
+//////////////////////////////////////////////////////////////////////
+class OpeningBook {
+  private:
+    MappedFile file; // The book's entries
+
+    // The entry at index, decoded from the file's byte order
+    BookEntry entry(std::size_t index) const;
+
+  public:
+    // Map a book file, closing any book already open
+    // Returns false if the file cannot be opened or is not a whole number of entries
+    bool open(const std::string& path);
+
+    // Unmap the book
+    void close() { file.close(); }
+
+    bool is_open() const { return file.is_open(); }
+
+    // Number of entries in the book
+    std::size_t size() const { return file.size() / BOOK_ENTRY_SIZE; }
+
+    // Every entry for a Polyglot key, in file order
+    std::vector<BookEntry> probe(U64 key) const;
+
+    // Choose a book move for the position
+    // Parameters:
+    //      State& state: The position; restored before returning
+    //      bool best: Choose the heaviest move instead of one at random in proportion to weight
+    //      MyMove& move: Set to the chosen move
+    // Returns false if the book has no legal move for the position
+    bool choose(State& state, bool best, MyMove& move) const;
+};
+
+}
+
+}
+
+#endif
@@ -5,8 +5,19 @@
 ////////////////////////////////////////////////////////////////////// 
 
 #include "custom_board.hpp"
+#include "bitboard.hpp"
+#include "bitbase.hpp"
+#include "impl/chess.hpp"
+#include "game.hpp"
+#include "move.hpp"
+#include "piece.hpp"
+#include "player.hpp"
 
 #include <cmath>
+#include <cstring>
+#include <random>
+#include <sstream>
+#include <stdexcept>
 
 namespace cpp_client
 {
@@ -29,7 +40,56 @@ U64 genShift(U64 x, int s) {
 };
 
 // Types that pawns can be promoted to
-const std::vector<const char*> promotions = {&ROOK, &KNIGHT, &BISHOP, &QUEEN};
+const PieceType promotions[] = {ROOK, KNIGHT, BISHOP, QUEEN};
+
+U64 ZOBRIST_PIECES[2][6][8][8];
+U64 ZOBRIST_SIDE;
+U64 ZOBRIST_CASTLING[16];
+U64 ZOBRIST_EN_PASSANT[8];
+U64 ZOBRIST_ROOT;
+
+// Fill the Zobrist tables from a fixed-seed xorshift generator so hashes
+// are reproducible between runs
+static bool init_zobrist()
+{
+  U64 seed = 0x9E3779B97F4A7C15ULL;
+  auto next = [&seed]()
+  {
+    seed ^= seed >> 12;
+    seed ^= seed << 25;
+    seed ^= seed >> 27;
+    return seed * 0x2545F4914F6CDD1DULL;
+  };
+  for (auto& owner : ZOBRIST_PIECES)
+    for (auto& piece : owner)
+      for (auto& file : piece)
+        for (U64& tile : file)
+          tile = next();
+  ZOBRIST_SIDE = next();
+  ZOBRIST_ROOT = next();
+  // No rights hashes to 0, so positions without castling keep their old keys
+  ZOBRIST_CASTLING[0] = 0;
+  for (int rights = 1; rights < 16; rights++)
+    ZOBRIST_CASTLING[rights] = next();
+  for (U64& file : ZOBRIST_EN_PASSANT)
+    file = next();
+  return true;
+}
+static const bool zobrist_ready = init_zobrist();
+
+// Zobrist key of a single tile; empty tiles hash to 0
+U64 zobrist(const MyPiece* piece, int i, int j)
+{
+  if (piece == nullptr)
+    return 0;
+  return ZOBRIST_PIECES[piece->owner][piece->type][i][j];
+}
+
+// Zobrist key of an en passant tile; no tile hashes to 0
+U64 zobrist_en_passant(int tile)
+{
+  return (tile < 0 ? 0 : ZOBRIST_EN_PASSANT[tile % 8]);
+}
 
 // Bounds checking
 bool iB(int i)
@@ -37,76 +97,97 @@ bool iB(int i)
   return 0 <= i && i < 8;
 }
 
-// Get the character representation of the name
-const char* shorten(std::string name)
+// Castling rights lost when a piece moves from or to each tile
+int castle_mask(int i, int j)
 {
-  if (name == "Knight")
-    return &KNIGHT;
-  else if (name == "King")
-    return &KING;
-  else if (name == "Queen")
-    return &QUEEN;
-  else if (name == "Bishop")
-    return &BISHOP;
-  else if (name == "Rook")
-    return &ROOK;
-  else if (name == "Pawn")
-    return &PAWN;
+  if (j == 0 || j == 7)
+  {
+    int owner = (j == 7);
+    if (i == 4)
+      return CASTLE_RIGHTS[owner][0] | CASTLE_RIGHTS[owner][1];
+    if (i == 7)
+      return CASTLE_RIGHTS[owner][0];
+    if (i == 0)
+      return CASTLE_RIGHTS[owner][1];
+  }
+  return 0;
 }
 
-// Unicode chess pieces
-std::string unicode(char repr)
+// Parse the castling field of a FEN, e.g. "KQkq"
+// Returns the CASTLE_RIGHTS bits, or -1 if the field is malformed
+int parse_castling(const std::string& field)
 {
-  switch(repr) {
-    case 'n':
-      return "\u2658";
-    case 'k':
-      return "\u2654";
-    case 'q':
-      return "\u2655";
-    case 'r':
-      return "\u2656";
-    case 'p':
-      return "\u2659";
-    case 'b':
-      return "\u2657";
-    case 'N':
-      return "\u265E";
-    case 'K':
-      return "\u265A";
-    case 'Q':
-      return "\u265B";
-    case 'R':
-      return "\u265C";
-    case 'P':
-      return "\u265F";
-    case 'B':
-      return "\u265D";
+  if (field == "-")
+    return 0;
+  int rights = 0;
+  for (char c : field)
+  {
+    int bit;
+    switch(c) {
+      case 'K': bit = CASTLE_RIGHTS[0][0]; break;
+      case 'Q': bit = CASTLE_RIGHTS[0][1]; break;
+      case 'k': bit = CASTLE_RIGHTS[1][0]; break;
+      case 'q': bit = CASTLE_RIGHTS[1][1]; break;
+      default: return -1;
+    }
+    rights |= bit;
   }
-  return " ";
+  return (field.empty() ? -1 : rights);
 }
 
-// Lengthen a name
-std::string lengthen(const char* name)
+// Parse the en passant field of a FEN, e.g. "e3"
+// Returns the tile numbered as in MyMove::id(), -1 for "-", or -2 if the field is malformed
+int parse_en_passant(const std::string& field)
 {
-  if (name == nullptr)
-    return "";
-  switch(*name) {
-    case KNIGHT:
-      return "Knight";
-    case KING:
-      return "King";
-    case QUEEN:
-      return "Queen";
-    case ROOK:
-      return "Rook";
-    case PAWN:
-      return "Pawn";
-    case BISHOP:
-      return "Bishop";
-  }
-  return "";
+  if (field == "-")
+    return -1;
+  if (field.size() != 2 || field[0] < 'a' || field[0] > 'h' || (field[1] != '3' && field[1] != '6'))
+    return -2;
+  return (field[0] - 'a') + 8 * (field[1] - '1');
+}
+
+// Unicode chess pieces, indexed [owner][type]; white uses the filled glyphs to show on a dark terminal
+const char* const GLYPHS[2][6] = {{"\u265F", "\u265E", "\u265D", "\u265C", "\u265B", "\u265A"},
+                                  {"\u2659", "\u2658", "\u2657", "\u2656", "\u2655", "\u2654"}};
 
+PieceType piece_from_symbol(char symbol)
+{
+  const char* found = std::strchr(PIECE_SYMBOLS[0], std::toupper(symbol));
+  if (symbol == '\0' || found == nullptr)
+    return NO_PIECE;
+  return static_cast<PieceType>(found - PIECE_SYMBOLS[0]);
+}
+
+uint16_t MyMove::id() const
+{
+  int promoted = 0;
+  for (int i = 0; i < 4; i++)
+    if (promotion == promotions[i])
+      promoted = i + 1;
+  return from() | to() << 6 | promoted << 12;
+}
+
+std::string uci_from_id(uint16_t id)
+{
+  int from = id & 63;
+  int to = (id >> 6) & 63;
+  int promoted = id >> 12;
+  std::string move;
+  move += static_cast<char>('a' + from % 8);
+  move += static_cast<char>('1' + from / 8);
+  move += static_cast<char>('a' + to % 8);
+  move += static_cast<char>('1' + to / 8);
+  if (promoted > 0)
+    move += PIECE_SYMBOLS[1][promotions[promoted - 1]];
+  return move;
+}
+
+std::string MyMove::uci() const
+{
+  std::string move = file + std::to_string(rank) + file2 + std::to_string(rank2);
+  if (promotion != NO_PIECE)
+    move += PIECE_SYMBOLS[1][promotion];
+  return move;
 }
 
 /*Board::Board(const Game& game)
@@ -114,88 +195,243 @@ std::string lengthen(const char* name)
 
 }*/
 
-bool State::in_check(int i, int j, int attacker) const
+State::State(const Game& game) : State(from_fen(game->fen))
+{
+  // Everything but the earlier positions is in the game's FEN
+  seed_history(game);
+}
+
+State::State()
 {
-  // Determine whether the given tile is under attack by the opponent
-  for (auto move: KNIGHT_MOVES)
+  // Construct an empty board
+  current_player = 0;
+  root_player = 0;
+  castling = 0;
+  en_passant = -1;
+  last_capture = 0;
+  root_ply = 0;
+  key = 0;
+
+  board = new MyPiece**[8];
+  for (int i = 0; i < 8; i++)
   {
-    int file = i + move.first;
-    int rank = j + move.second;
-    if (iB(file) && iB(rank))
+    board[i] = new MyPiece*[8];
+    for (int j = 0; j < 8; j++)
     {
-      auto* piece = board[file][rank];
-      if (piece != nullptr && piece->owner == attacker && piece->type == &KNIGHT)
-        return true;
+      board[i][j] = nullptr;
     }
   }
+  compute_bitboards();
+}
 
-  // Look in reverse direction since we are starting at the target
-  for (auto move: PAWN_ATTACKS[(attacker + 1) % 2])
+State State::from_fen(const std::string& fen)
+{
+  std::istringstream stream(fen);
+  std::vector<std::string> fields;
+  std::string field;
+  while (stream >> field)
+    fields.push_back(field);
+  if (fields.size() < 2)
+    throw std::invalid_argument("FEN needs at least piece placement and active color: \"" + fen + "\"");
+
+  State state;
+
+  // Piece placement, from rank 8 down to rank 1
+  int i = 0, j = 7;
+  int kings[2] = {0, 0};
+  for (char c : fields[0])
+  {
+    if (c == '/')
+    {
+      if (i != 8 || j == 0)
+        throw std::invalid_argument("Bad rank in FEN piece placement: \"" + fields[0] + "\"");
+      i = 0;
+      j--;
+    }
+    else if ('1' <= c && c <= '8')
+      i += c - '0';
+    else
+    {
+      PieceType type = piece_from_symbol(c);
+      if (type == NO_PIECE)
+        throw std::invalid_argument(std::string("Unknown piece '") + c + "' in FEN");
+      if (i > 7)
+        throw std::invalid_argument("Too many tiles in FEN rank: \"" + fields[0] + "\"");
+      bool owner = std::islower(c);
+      if (type == PAWN && (j == 0 || j == 7))
+        throw std::invalid_argument("Pawn on the first or last rank in FEN: \"" + fields[0] + "\"");
+      // Pawns not in their starting rank have already moved
+      bool moved = (type == PAWN && j != (owner == 0 ? 1 : 6));
+      if (type == KING)
+        kings[owner]++;
+      state.board[i][j] = new MyPiece(type, moved, owner);
+      i++;
+    }
+    if (i > 8)
+      throw std::invalid_argument("Too many tiles in FEN rank: \"" + fields[0] + "\"");
+  }
+  if (i != 8 || j != 0)
+    throw std::invalid_argument("FEN piece placement does not cover the board: \"" + fields[0] + "\"");
+  if (kings[0] != 1 || kings[1] != 1)
+    throw std::invalid_argument("FEN must have exactly one king per player: \"" + fields[0] + "\"");
+  state.compute_bitboards();
+
+  if (fields[1] != "w" && fields[1] != "b")
+    throw std::invalid_argument("FEN active color must be w or b: \"" + fields[1] + "\"");
+  state.current_player = (fields[1] == "b");
+  state.root_player = state.current_player;
+
+  state.castling = parse_castling(fields.size() > 2 ? fields[2] : "-");
+  if (state.castling < 0)
+    throw std::invalid_argument("Bad FEN castling field: \"" + fields[2] + "\"");
+  // Rights without the king and rook in place cannot be used
+  for (int owner = 0; owner < 2; owner++)
   {
-    int file = i + move.first;
-    int rank = j + move.second;
-    if (iB(file) && iB(rank))
+    int back = (owner == 0 ? 0 : 7);
+    const MyPiece* k = state.board[4][back];
+    for (int side = 0; side < 2; side++)
     {
-      auto* piece = board[file][rank];
-      if (piece != nullptr && piece->owner == attacker && piece->type == &PAWN)
-        return true;
+      const MyPiece* r = state.board[side == 0 ? 7 : 0][back];
+      if (k == nullptr || k->type != KING || k->owner != owner || r == nullptr || r->type != ROOK || r->owner != owner)
+        state.castling &= ~CASTLE_RIGHTS[owner][side];
     }
   }
 
-  for (auto move: KING_MOVES)
+  state.en_passant = parse_en_passant(fields.size() > 3 ? fields[3] : "-");
+  if (state.en_passant < -1 || (state.en_passant >= 0 && state.en_passant / 8 != (state.current_player == 0 ? 5 : 2)))
+    throw std::invalid_argument("Bad FEN en passant field: \"" + fields[3] + "\"");
+  if (!state.en_passant_capturable(state.en_passant))
+    state.en_passant = -1;
+
+  if (fields.size() > 4)
   {
-    int fd = move.first;
-    int rd = move.second;
-    for (int range = 1; range < 8; range++)
-    {
-      int file = i + fd * range;
-      int rank = j + rd * range;
-      if (!iB(file) || !iB(rank))
-        break;
+    const std::string& clock = fields[4];
+    if (clock.empty() || clock.size() > 4 || clock.find_first_not_of("0123456789") != std::string::npos)
+      throw std::invalid_argument("Bad FEN halfmove clock: \"" + clock + "\"");
+    state.last_capture = std::atoi(clock.c_str());
+  }
 
-      auto *piece = board[file][rank];
-      if (piece != nullptr)
+  int fullmove = 1;
+  if (fields.size() > 5)
+  {
+    const std::string& moves = fields[5];
+    if (moves.empty() || moves.size() > 5 || moves.find_first_not_of("0123456789") != std::string::npos)
+      throw std::invalid_argument("Bad FEN fullmove number: \"" + moves + "\"");
+    fullmove = std::max(1, std::atoi(moves.c_str()));
+  }
+  state.root_ply = 2 * (fullmove - 1) + state.current_player;
+
+  // The player who just moved cannot have left their king attacked
+  state.current_player = !state.current_player;
+  bool capturable_king = state.in_check();
+  state.current_player = !state.current_player;
+  if (capturable_king)
+    throw std::invalid_argument("FEN leaves the player not to move in check: \"" + fen + "\"");
+
+  state.key = state.compute_key();
+  return state;
+}
+
+std::string State::to_fen() const
+{
+  std::string fen;
+  for (int j = 7; j >= 0; j--)
+  {
+    int empty = 0;
+    for (int i = 0; i < 8; i++)
+    {
+      const MyPiece* piece = board[i][j];
+      if (piece == nullptr)
       {
-        if (piece->owner == attacker)
-        {
-          if ((range == 1 && piece->type == &KING) || (piece->type == &QUEEN) || (piece->type == &BISHOP && (abs(fd + rd) == 2 || fd + rd == 0)) || (piece->type == &ROOK && abs(fd + rd) == 1))
-          {
-            return true;
-          }
-        }
-        break;
+        empty++;
+        continue;
       }
+      if (empty > 0)
+        fen += static_cast<char>('0' + empty);
+      empty = 0;
+      fen += PIECE_SYMBOLS[piece->owner][piece->type];
     }
+    if (empty > 0)
+      fen += static_cast<char>('0' + empty);
+    if (j > 0)
+      fen += '/';
   }
-  return false;
-}
 
-State::State(const Game& game)
-{
-  // Construct the state from the game
-  current_player = (game->current_turn % 2);
+  fen += (current_player == 0 ? " w " : " b ");
 
-  board = new MyPiece**[8];
-  for (int i = 0; i < 8; i++)
+  const char rights[] = {'K', 'Q', 'k', 'q'};
+  int written = 0;
+  for (int owner = 0; owner < 2; owner++)
   {
-    board[i] = new MyPiece*[8];
-    for (int j = 0; j < 8; j++)
+    for (int side = 0; side < 2; side++)
     {
-      board[i][j] = nullptr;
+      if (castling & CASTLE_RIGHTS[owner][side])
+      {
+        fen += rights[owner * 2 + side];
+        written++;
+      }
     }
   }
+  if (written == 0)
+    fen += '-';
 
-  for (cpp_client::chess::Piece piece : game->pieces)
+  if (en_passant < 0)
+    fen += " -";
+  else
   {
-    int i = piece->file[0] - 'a';
-    int j = piece->rank - 1;
-    bool actually_moved = piece->has_moved;
-    // Pawns not in their starting rank have already moved
-    if (piece->type == "Pawn" && piece->rank != (piece->owner == game->players[0] ? 2 : 6))
-      actually_moved = true;
-    board[i][j] = new MyPiece(shorten(piece->type), actually_moved, piece->owner == game->players[1]); 
+    fen += ' ';
+    fen += static_cast<char>('a' + en_passant % 8);
+    fen += static_cast<char>('1' + en_passant / 8);
   }
 
+  int ply = root_ply + static_cast<int>(past_irreversible.size());
+  fen += " " + std::to_string(last_capture) + " " + std::to_string(ply / 2 + 1);
+  return fen;
+}
+
+void State::seed_history(const Game& game)
+{
+  // Step back through the reversible moves on a scratch board, hashing each earlier position
+  State past(*this);
+  for (int m = static_cast<int>(game->moves.size()) - 1; m >= 0 && static_cast<int>(past_keys.size()) < last_capture; m--)
+  {
+    const Move& move = game->moves[m];
+    int i = move->from_file[0] - 'a';
+    int j = move->from_rank - 1;
+    int i2 = move->to_file[0] - 'a';
+    int j2 = move->to_rank - 1;
+    MyPiece* piece = past.board[i2][j2];
+
+    // Castling cannot be repeated across, and anything else irreversible ends the window
+    if (piece == nullptr || past.board[i][j] != nullptr || (piece->type == KING && abs(i2 - i) == 2))
+      break;
+
+    // A king or rook leaving its starting tile may have taken castling rights with it;
+    // which rights it had is not known, so the positions before it cannot be hashed
+    int own_rights = CASTLE_RIGHTS[piece->owner][0] | CASTLE_RIGHTS[piece->owner][1];
+    if ((piece->type == KING || piece->type == ROOK) && (castle_mask(i, j) & own_rights) != 0)
+      break;
+
+    past.board[i][j] = piece;
+    past.board[i2][j2] = nullptr;
+    past.current_player = !past.current_player;
+
+    // The position after a double pawn push may allow an en passant capture; no pawn moves
+    // inside the window, so the current pawn bitboards answer for the earlier position too
+    past.en_passant = -1;
+    if (m > 0)
+    {
+      const Move& push = game->moves[m - 1];
+      int pi = push->to_file[0] - 'a';
+      int tile = pi + 8 * ((push->from_rank + push->to_rank) / 2 - 1);
+      const MyPiece* pawn = past.board[pi][push->to_rank - 1];
+      if (pawn != nullptr && pawn->type == PAWN && abs(push->to_rank - push->from_rank) == 2 && past.en_passant_capturable(tile))
+        past.en_passant = tile;
+    }
+    past.key = past.compute_key();
+    past_keys.push_back(past.key);
+  }
+  std::reverse(past_keys.begin(), past_keys.end());
 }
 
 State::State(const State& original)
@@ -218,6 +454,17 @@ State::State(const State& original)
     }
   }
   current_player = original.current_player;
+  root_player = original.root_player;
+  castling = original.castling;
+  en_passant = original.en_passant;
+  last_capture = original.last_capture;
+  root_ply = original.root_ply;
+  key = original.key;
+  std::copy(&original.pieces[0][0], &original.pieces[0][0] + 2 * 6, &pieces[0][0]);
+  occupied[0] = original.occupied[0];
+  occupied[1] = original.occupied[1];
+  past_keys = original.past_keys;
+  past_irreversible = original.past_irreversible;
 }
 
 State::~State()
@@ -231,7 +478,7 @@ State::~State()
   delete[] board;
 }
 
-bool State::quiescent(const Game &game)
+bool State::quiescent()
 {
   current_player = !current_player;
   bool chk = in_check();
@@ -239,611 +486,384 @@ bool State::quiescent(const Game &game)
   return !chk;
 }
 
-std::vector<MyMove> State::ACTIONS(const Game &game)
+// Board geometry for each side, fixed at compile time
+template <bool Us>
+struct Side {
+    static constexpr int FORWARD = (Us ? -1 : 1); // Rank direction pawns advance in
+    static constexpr int START_RANK = (Us ? 6 : 1); // Rank pawns may advance two from
+    static constexpr int LAST_RANK = (Us ? 0 : 7); // Rank pawns promote on
+};
+
+// Files on either side of a pawn
+constexpr int PAWN_SIDES[2] = {-1, 1};
+
+// Tiles a slider of each kind on sq attacks, given the occupied tiles
+U64 straight_attacks(int sq, U64 occupied)
 {
-  std::vector<MyMove> moves;
+  return ray_attacks(0, sq, occupied) | ray_attacks(1, sq, occupied) | ray_attacks(2, sq, occupied) | ray_attacks(3, sq, occupied);
+}
+U64 diagonal_attacks(int sq, U64 occupied)
+{
+  return ray_attacks(4, sq, occupied) | ray_attacks(5, sq, occupied) | ray_attacks(6, sq, occupied) | ray_attacks(7, sq, occupied);
+}
 
-  // Determine ability to castle & en passant
-  int j = 0;
-  for (int i = 0; i < 4; i++)
+template <bool Attacker>
+U64 State::attackers(int sq) const
+{
+  const U64* them = pieces[Attacker];
+  U64 found = (KNIGHT_ATTACKS[sq] & them[KNIGHT])
+            | (KING_ATTACKS[sq] & them[KING])
+            // Attacking pawns stand where a pawn of ours on sq would attack
+            | (PAWN_ATTACKS[!Attacker][sq] & them[PAWN]);
+
+  // Look outward along each line a slider could be on for the first piece
+  U64 straight = them[ROOK] | them[QUEEN];
+  U64 diagonal = them[BISHOP] | them[QUEEN];
+  U64 all = occupied[0] | occupied[1];
+  for (int dir = 0; dir < 8; dir++)
   {
-    while(game->fen[j++] != ' ');
-    i++;
+    U64 sliders = (dir < 4 ? straight : diagonal);
+    if (RAYS[dir][sq] & sliders)
+      found |= ray_attacks(dir, sq, all) & sliders;
   }
+  return found;
+}
 
-  std::string token = game->fen.substr(j);
-  std::string castle = token.substr(0, token.find(" "));
-  while(game->fen[j++] != ' ');
-  token = game->fen.substr(j);
-  std::string enPassant = token.substr(0, token.find(" "));
+template <bool Attacker>
+bool State::attacked(int i, int j) const
+{
+  return attackers<Attacker>(i + 8 * j) != 0;
+}
 
-  // Iterate through the entire board
-  for (int i = 0; i < 8; i++)
-  {
-    for (int j = 0; j < 8; j++)
-    {
-      if (board[i][j] == nullptr || board[i][j]->owner != current_player)
-      {
-        continue;
-      }
-      MyPiece* piece = board[i][j];
-      const char* type = piece->type;
+bool State::in_check(int i, int j, int attacker) const
+{
+  return (attacker ? attacked<true>(i, j) : attacked<false>(i, j));
+}
 
-      const int forward = (current_player == 0 ? 1 : -1);
-      char file = 'a' + i;
-      int rank = j + 1;
+template <bool Us, GenType Type>
+void State::piece_moves(int i, int j, std::vector<MyMove>& moves)
+{
+  // Which halves of the move list this generation type wants
+  const bool captures = (Type != QUIETS);
+  const bool quiets = (Type != CAPTURES);
 
-      
-      if (type == &PAWN)
-      {
-        // Pawns can move 2 spaces forward if
-        //    there are no pieces between the pawn and the target square or on the target square,
-        //    the pawn is in its starting rank
-        if (iB(j+forward*2) && !piece->has_moved && board[i][j+forward] == nullptr && board[i][j+forward*2] == nullptr)
-        {
-            moves.push_back(MyMove(file, rank, file, rank + forward*2));
-        }
+  const MyPiece* piece = board[i][j];
+  char file = 'a' + i;
+  int rank = j + 1;
 
-        // Pawns can move 1 space forward if
-        //    there are no pieces on the target square
-        if (iB(j+forward) && board[i][j+forward] == nullptr)
-        {
-          // Pawns can be promoted 
-          //    if they advance to the final rank
-          if (0 == j + forward || 7 == j + forward)
-          {
-            for (auto promotion : promotions)
-            {
-              moves.push_back(MyMove(file, rank, file, rank + forward, nullptr, promotion));
-            }
-          }
-          else
-            moves.push_back(MyMove(file, rank, file, rank + forward));
-        }
+  // Tiles a king, knight or slider may land on: enemy pieces for captures, empty tiles for quiet moves
+  const U64 targets = (captures ? occupied[!Us] : 0) | (quiets ? ~(occupied[0] | occupied[1]) : 0);
 
-        // Pawns can move 1 space forward diagonally if
-        //    there is an enemy piece on the target square
-        for (int dir : LR)
+  switch(piece->type) {
+    case PAWN:
+    {
+      const int forward = Side<Us>::FORWARD;
+      const bool promotes = (j + forward == Side<Us>::LAST_RANK);
+
+      // Pawns can move 1 space forward if
+      //    there are no pieces on the target square
+      // and 2 spaces if they are also in their starting rank with nothing in the way
+      // Promotions count as captures, since they change the material balance
+      if (board[i][j+forward] == nullptr)
+      {
+        if (promotes)
         {
-          if (iB(i+dir) && iB(j+forward) && board[i+dir][j+forward] != nullptr)
-          {
-            MyPiece *captured = board[i+dir][j+forward];
-            if (piece->owner != captured->owner)
-            {
-              // Pawns can be promoted 
-              //    if they advance to the final rank
-              if (j + forward == 0 || j + forward == 7)
-              {
-                for (auto promotion : promotions)
-                {
-                  moves.push_back(MyMove(file, rank, file+dir, rank+forward, captured->type, promotion));
-                }
-              }
-              else
-                moves.push_back(MyMove(file, rank, file+dir, rank+forward));
-            }
-          }
+          if (captures)
+            for (auto promotion : promotions)
+              moves.push_back(MyMove(file, rank, file, rank + forward, NO_PIECE, promotion));
         }
-
-
-
-        // Pawns can perform En Passant if
-        //    the previous move was a pawn advancing two squares
-        //    the pawn is now adjacent to this pawn
-        if (enPassant[0] != '-')
+        else if (quiets)
         {
-          if ((enPassant[1] - '0' - rank - forward) == 0 && abs((int)(enPassant[0] - 'a') - i) == 1)
-            {
-              int dir = enPassant[0] - file;
-              moves.push_back(MyMove(file, rank, file+dir, rank+forward, 0, "En Passant"));
-            }
+          moves.push_back(MyMove(file, rank, file, rank + forward));
+          if (j == Side<Us>::START_RANK && board[i][j+forward*2] == nullptr)
+            moves.push_back(MyMove(file, rank, file, rank + forward*2));
         }
-
-
-
       }
-      else if (type == &KING)
-      {
-        // Kings can move 1 space in any direction if
-        //    the target square is not a piece owned by the player
-        for (auto direction: KING_MOVES)
-        {
-          int fd = direction.first; int rd = direction.second;
-          if (!iB(i+fd) || !iB(j+rd))
-            continue;
-          auto *newloc = board[i+fd][j+rd];
-          if (newloc == nullptr || newloc->owner != current_player)
-            moves.push_back(MyMove(file, rank, file+fd, rank+rd, newloc == nullptr ? nullptr : newloc->type));
-        }
 
-        // The king can castle with a friendly rook if
-        //    both it and the castling rook have not moved,
-        //    the king does not pass through a square that is attacked,
-        //    the king is not in check,
-        //    there are no pieces between the rook and the king,
-        //    the target square is not a piece owned by the player
-        if (!piece->has_moved)
-        {
-          for (auto direction : CASTLING)
-          {
-            char side = (direction.first == -4 ? 'Q' : 'K');
-            if (piece->owner == 1)
-            {
-              side = std::tolower(side);
-            }
-            if (castle.find(side) > 3)
-              continue;
-
-            bool can_castle = true;
-            int fd = direction.first; int rd = direction.second;            
-            int inc = fd > 0;
-
-            MyPiece* castle = board[i+fd][j+rd];
-            if (castle == nullptr || castle->has_moved)
-              can_castle = false;
-            else
-            {
-              int m = i; 
-              if (inc)
-                while(m <= i + 2)
-                {
-                  if (in_check(m, j, (current_player + 1)%2) || (m != i && board[m][j] != nullptr))
-                  {
-                    can_castle = false;
-                    break;
-                  }
-                  m++;
-                }
-              else
-                while(m >= i - 3)
-                {
-                  if ((m >= i - 2 && in_check(m, j, (current_player + 1)%2)) || (m != i && board[m][j] != nullptr))
-                  {
-                    can_castle = false;
-                    break;
-                  }
-                  m--;
-                }
-            }
-            if (can_castle)
-            {
-              moves.push_back(MyMove(file, rank, file + (inc ? 2 : -2), rank+rd, 0, "Castle"));
-            }
-          }
-        }
+      if (!captures)
+        break;
 
-      }
-      else if (type == &QUEEN)
+      // Pawns can move 1 space forward diagonally if
+      //    there is an enemy piece on the target square
+      for (int dir : PAWN_SIDES)
       {
-        // Queens can move any number of spaces in any direction if
-        //    there are no pieces between the Queen and the target square,
-        //    the target square is not a piece owned by the player
-        for (auto direction: KING_MOVES)
+        if (!iB(i+dir))
+          continue;
+        const MyPiece* captured = board[i+dir][j+forward];
+        if (captured == nullptr || captured->owner == Us)
+          continue;
+        if (promotes)
         {
-          for (int r = 1; r < 8; r++)
-          {
-            int fd = direction.first; int rd = direction.second;
-            if (!iB(i+fd*r) || !iB(j+rd*r))
-              break;
-            auto *newloc = board[i+fd*r][j+rd*r];
-            if (newloc == nullptr)
-              moves.push_back(MyMove(file, rank, file+fd*r, rank+rd*r));
-            else 
-            {
-              if (newloc->owner != current_player)
-                moves.push_back(MyMove(file, rank, file+fd*r, rank+rd*r, newloc->type));
-              break;
-            }
-          }
+          for (auto promotion : promotions)
+            moves.push_back(MyMove(file, rank, file+dir, rank+forward, captured->type, promotion));
         }
+        else
+          moves.push_back(MyMove(file, rank, file+dir, rank+forward, captured->type));
       }
-      else if (type == &KNIGHT)
+
+      // Pawns can perform En Passant if
+      //    the previous move was a pawn advancing two squares
+      //    the pawn is now adjacent to this pawn
+      if (en_passant >= 0 && en_passant / 8 == j + forward && abs(en_passant % 8 - i) == 1)
       {
-        // Knights can move in an L shape if
-        //    the target square is not a piece owned by the player
-        for (auto direction: KNIGHT_MOVES)
-        {
-          int fd = direction.first; int rd = direction.second;
-          if (!iB(i+fd) || !iB(j+rd))
-            continue;
-          auto *newloc = board[i+fd][j+rd];
-          if (newloc == nullptr || newloc->owner != current_player)
-            moves.push_back(MyMove(file, rank, file+fd, rank+rd, newloc == nullptr ? nullptr : newloc->type));
-        }
+        int dir = en_passant % 8 - i;
+        moves.push_back(MyMove(file, rank, file+dir, rank+forward, PAWN, NO_PIECE, "En Passant"));
       }
-      else if (type == &ROOK)
+      break;
+    }
+    case KING:
+    {
+      // Kings can move 1 space in any direction if
+      //    the target square is not a piece owned by the player
+      add_moves(i, j, KING_ATTACKS[i + 8 * j] & targets, moves);
+
+      // The king can castle with a friendly rook if
+      //    the player still has the right to castle on that side,
+      //    the king is not in check and does not pass through or land on a square that is attacked,
+      //    there are no pieces between the rook and the king
+      if (!quiets || Type == EVASIONS)
+        break;
+      for (int side = 0; side < 2; side++)
       {
-        // Rooks can move any number of spaces across a rank or file if
-        //    there are no pieces between the rook and the target square,
-        //    the target square is not a piece owned by the player
-        for (auto direction: ROOK_MOVES)
-        {
-          for (int r = 1; r < 8; r++)
-          {
-            int fd = direction.first; int rd = direction.second;
-            if (!iB(i+fd*r) || !iB(j+rd*r))
-              break;
-            auto *newloc = board[i+fd*r][j+rd*r];
-            if (newloc == nullptr)
-              moves.push_back(MyMove(file, rank, file+fd*r, rank+rd*r));
-            else 
-            {
-              if (newloc->owner != current_player)
-                moves.push_back(MyMove(file, rank, file+fd*r, rank+rd*r, newloc->type));
-              break;
-            }
-          }
-        }
+        if (!(castling & CASTLE_RIGHTS[Us][side]))
+          continue;
+
+        int step = (side == 0 ? 1 : -1);
+        int rook = (side == 0 ? 7 : 0);
+        bool can_castle = true;
+        for (int m = i + step; m != rook && can_castle; m += step)
+          can_castle = (board[m][j] == nullptr);
+        for (int m = 0; m <= 2 && can_castle; m++)
+          can_castle = !attacked<!Us>(i + step * m, j);
+
+        if (can_castle)
+          moves.push_back(MyMove(file, rank, file + 2 * step, rank, NO_PIECE, NO_PIECE, "Castle"));
       }
-      else if (type == &BISHOP)
-      {
-        // Bishops can move diagonally if
-        //    there are no pieces between the bishop and the target
-        //    the target square is not a piece owned by the player
-        for (auto direction: BISHOP_MOVES)
-        {
-          for (int r = 1; r < 8; r++)
-          {
-            int fd = direction.first; int rd = direction.second;
-            if (!iB(i+fd*r) || !iB(j+rd*r))
-              break;
-            auto *newloc = board[i+fd*r][j+rd*r];
-            if (newloc == nullptr)
-              moves.push_back(MyMove(file, rank, file+fd*r, rank+rd*r));
-            else 
-            {
-              if (newloc->owner != current_player)
-                moves.push_back(MyMove(file, rank, file+fd*r, rank+rd*r, newloc->type));
-              break;
-            }
-          }
-        }
+      break;
+    }
+    default:
+    {
+      // Queens, rooks and bishops can move any number of spaces in their directions,
+      // knights in an L shape, if
+      //    there are no pieces between the piece and the target square,
+      //    the target square is not a piece owned by the player
+      int sq = i + 8 * j;
+      U64 all = occupied[0] | occupied[1];
+      U64 reach;
+      switch(piece->type) {
+        case QUEEN: reach = straight_attacks(sq, all) | diagonal_attacks(sq, all); break;
+        case ROOK: reach = straight_attacks(sq, all); break;
+        case BISHOP: reach = diagonal_attacks(sq, all); break;
+        default: reach = KNIGHT_ATTACKS[sq]; break;
       }
+      add_moves(i, j, reach & targets, moves);
     }
   }
+}
 
-
-  
-  // All moves  must be validated such that
-  //    they do not put their own king into check
-  for (int i = 0; i < moves.size(); i++)
+void State::add_moves(int i, int j, U64 targets, std::vector<MyMove>& moves) const
+{
+  char file = 'a' + i;
+  int rank = j + 1;
+  for (; targets; targets &= targets - 1)
   {
-    if (in_check(moves[i]))
-    {
-      moves.erase(moves.begin() + i);
-      i--;
-    }
+    int to = lsb(targets);
+    const MyPiece* captured = board[to % 8][to / 8];
+    moves.push_back(MyMove(file, rank, 'a' + to % 8, to / 8 + 1, captured == nullptr ? NO_PIECE : captured->type));
   }
-  std::random_shuffle(moves.begin(), moves.end());
+}
 
-  // Now order captures to be first
+template <bool Us>
+void State::keep_evasions(std::vector<MyMove>& moves) const
+{
+  int king = lsb(pieces[Us][KING]);
+  U64 checkers = attackers<!Us>(king);
+  if (checkers == 0)
+    return;
+
+  // Tiles a piece other than the king can move to to stop the check:
+  //    the checking piece's, or between a checking slider and the king.
+  //    In double check only the king can move
+  U64 blocks = 0;
+  if (popcount(checkers) == 1)
+    blocks = checkers | BETWEEN(king, lsb(checkers));
+
+  auto useless = [&](const MyMove& move)
+  {
+    if (move.from() == king)
+      return false;
+    return !((blocks >> move.to()) & 1) && move.move_type != "En Passant";
+  };
+  moves.erase(std::remove_if(moves.begin(), moves.end(), useless), moves.end());
+}
 
-  int k = 0;
-  for (int i = 0; i < moves.size() - k; i++)
+template <bool Us, GenType Type>
+void State::generate(std::vector<MyMove>& moves)
+{
+  // Iterate through the entire board
+  for (int i = 0; i < 8; i++)
   {
-    if (moves[i].capture != nullptr)
+    for (int j = 0; j < 8; j++)
     {
-      moves.push_back(moves[i]);
-      moves.erase(moves.begin() + i);
-      i--;
-      k++;
+      if (board[i][j] != nullptr && board[i][j]->owner == Us)
+        piece_moves<Us, Type>(i, j, moves);
     }
   }
 
-  std::reverse(moves.begin(), moves.end());
-
-  return moves;
+  if (Type == EVASIONS)
+    keep_evasions<Us>(moves);
 }
 
-bool State::actions_exist(const Game &game)
+U64 State::pinned() const
 {
-  // string in SAN
-  std::vector<MyMove> moves;
+  int king = lsb(pieces[current_player][KING]);
+  const U64* them = pieces[!current_player];
+  U64 all = occupied[0] | occupied[1];
 
-  // Determine ability to castle & en passant
-  int j = 0;
-  for (int i = 0; i < 4; i++)
+  // Enemy sliders that would attack the king on an empty board
+  U64 straight = RAYS[0][king] | RAYS[1][king] | RAYS[2][king] | RAYS[3][king];
+  U64 diagonal = RAYS[4][king] | RAYS[5][king] | RAYS[6][king] | RAYS[7][king];
+  U64 snipers = (straight & (them[ROOK] | them[QUEEN])) | (diagonal & (them[BISHOP] | them[QUEEN]));
+
+  U64 pins = 0;
+  for (; snipers; snipers &= snipers - 1)
   {
-    while(game->fen[j++] != ' ');
-    i++;
+    U64 blockers = BETWEEN(king, lsb(snipers)) & all;
+    if (popcount(blockers) == 1)
+      pins |= blockers & occupied[current_player];
   }
+  return pins;
+}
 
-  std::string token = game->fen.substr(j);
-  std::string castle = token.substr(0, token.find(" "));
-  while(game->fen[j++] != ' ');
-  token = game->fen.substr(j);
-  std::string enPassant = token.substr(0, token.find(" "));
+bool State::exposes_king(const MyMove& action, U64 pins, bool check)
+{
+  int from = action.from();
+  if (!check && !((pieces[current_player][KING] >> from) & 1) && action.move_type != "En Passant")
+  {
+    // A pinned piece stays between its king and the pinning slider while it moves along their line
+    if (!((pins >> from) & 1))
+      return false;
+    return !((LINE(lsb(pieces[current_player][KING]), from) >> action.to()) & 1);
+  }
+  return in_check(action);
+}
+
+template <bool Us>
+bool State::any_legal()
+{
+  std::vector<MyMove> moves;
+  const U64 pins = pinned();
+  const bool check = in_check();
 
   // Iterate through the entire board
   for (int i = 0; i < 8; i++)
   {
     for (int j = 0; j < 8; j++)
     {
-      if (board[i][j] == nullptr || board[i][j]->owner != current_player)
-      {
+      if (board[i][j] == nullptr || board[i][j]->owner != Us)
         continue;
-      }
-      MyPiece* piece = board[i][j];
-      const char* type = piece->type;
 
-      const int forward = (current_player == 0 ? 1 : -1);
-      char file = 'a' + i;
-      int rank = j + 1;
-
-      
-      if (type == &PAWN)
+      // If one of this piece's moves is valid, return it
+      moves.clear();
+      piece_moves<Us, ALL>(i, j, moves);
+      for (const MyMove& move : moves)
       {
-        // Pawns can move 2 spaces forward if
-        //    there are no pieces between the pawn and the target square or on the target square,
-        //    the pawn is in its starting rank
-        if (iB(j+forward*2) && !piece->has_moved && board[i][j+forward] == nullptr && board[i][j+forward*2] == nullptr)
-        {
-            moves.push_back(MyMove(file, rank, file, rank + forward*2));
-        }
-
-        // Pawns can move 1 space forward if
-        //    there are no pieces on the target square
-        if (iB(j+forward) && board[i][j+forward] == nullptr)
-        {
-          // Pawns can be promoted 
-          //    if they advance to the final rank
-          if (0 == j + forward || 7 == j + forward)
-          {
-            for (auto promotion : promotions)
-            {
-              moves.push_back(MyMove(file, rank, file, rank + forward, nullptr, promotion));
-            }
-          }
-          else
-            moves.push_back(MyMove(file, rank, file, rank + forward));
-        }
+        if (!exposes_king(move, pins, check))
+          return true;
+      }
+    }
+  }
 
-        // Pawns can move 1 space forward diagonally if
-        //    there is an enemy piece on the target square
-        for (int dir : LR)
-        {
-          if (iB(i+dir) && iB(j+forward) && board[i+dir][j+forward] != nullptr)
-          {
-            MyPiece *captured = board[i+dir][j+forward];
-            if (piece->owner != captured->owner)
-            {
-              // Pawns can be promoted 
-              //    if they advance to the final rank
-              if (j + forward == 0 || j + forward == 7)
-              {
-                for (auto promotion : promotions)
-                {
-                  moves.push_back(MyMove(file, rank, file+dir, rank+forward, captured->type, promotion));
-                }
-              }
-              else
-                moves.push_back(MyMove(file, rank, file+dir, rank+forward));
-            }
-          }
-        }
+  return false;
+}
 
+bool State::en_passant_capturable(int tile) const
+{
+  // A pawn of ours that could capture onto the tile stands where an enemy pawn on it would attack
+  return tile >= 0 && (PAWN_ATTACKS[!current_player][tile] & pieces[current_player][PAWN]) != 0;
+}
 
+// The calling thread's generator for shuffling moves, so threads never share one
+static std::mt19937& shuffle_generator()
+{
+  static thread_local std::mt19937 generator(std::random_device{}());
+  return generator;
+}
 
-        // Pawns can perform En Passant if
-        //    the previous move was a pawn advancing two squares
-        //    the pawn is now adjacent to this pawn
-        if (enPassant[0] != '-')
-        {
-          if ((enPassant[1] - '0' - rank - forward) == 0 && abs((int)(enPassant[0] - 'a') - i) == 1)
-            {
-              int dir = enPassant[0] - file;
-              moves.push_back(MyMove(file, rank, file+dir, rank+forward, 0, "En Passant"));
-            }
-        }
+void State::seed_shuffle(unsigned seed)
+{
+  shuffle_generator().seed(seed);
+}
 
+std::vector<MyMove> State::ACTIONS(GenType type)
+{
+  std::vector<MyMove> moves;
 
+  // Out of check, only moves that resolve it are worth generating
+  if (type == ALL && in_check())
+    type = EVASIONS;
 
-      }
-      else if (type == &KING)
-      {
-        // Kings can move 1 space in any direction if
-        //    the target square is not a piece owned by the player
-        for (auto direction: KING_MOVES)
-        {
-          int fd = direction.first; int rd = direction.second;
-          if (!iB(i+fd) || !iB(j+rd))
-            continue;
-          auto *newloc = board[i+fd][j+rd];
-          if (newloc == nullptr || newloc->owner != current_player)
-            moves.push_back(MyMove(file, rank, file+fd, rank+rd, newloc == nullptr ? nullptr : newloc->type));
-        }
+  // Pick the generator specialized for this side and generation type
+  if (current_player)
+  {
+    switch(type) {
+      case CAPTURES: generate<true, CAPTURES>(moves); break;
+      case QUIETS: generate<true, QUIETS>(moves); break;
+      case EVASIONS: generate<true, EVASIONS>(moves); break;
+      case ALL: generate<true, ALL>(moves); break;
+    }
+  }
+  else
+  {
+    switch(type) {
+      case CAPTURES: generate<false, CAPTURES>(moves); break;
+      case QUIETS: generate<false, QUIETS>(moves); break;
+      case EVASIONS: generate<false, EVASIONS>(moves); break;
+      case ALL: generate<false, ALL>(moves); break;
+    }
+  }
 
-        // The king can castle with a friendly rook if
-        //    both it and the castling rook have not moved,
-        //    the king does not pass through a square that is attacked,
-        //    the king is not in check,
-        //    there are no pieces between the rook and the king,
-        //    the target square is not a piece owned by the player
-        if (!piece->has_moved)
-        {
-          for (auto direction : CASTLING)
-          {
-            char side = (direction.first == -4 ? 'Q' : 'K');
-            if (piece->owner == 1)
-            {
-              side = std::tolower(side);
-            }
-            if (castle.find(side) > 3)
-              continue;
-
-            bool can_castle = true;
-            int fd = direction.first; int rd = direction.second;            
-            int inc = fd > 0;
-
-            MyPiece* castle = board[i+fd][j+rd];
-            if (castle == nullptr || castle->has_moved)
-              can_castle = false;
-            else
-            {
-              int m = i; 
-              if (inc)
-                while(m <= i + 2)
-                {
-                  if (in_check(m, j, (current_player + 1)%2) || (m != i && board[m][j] != nullptr))
-                  {
-                    can_castle = false;
-                    break;
-                  }
-                  m++;
-                }
-              else
-                while(m >= i - 3)
-                {
-                  if ((m >= i - 2 && in_check(m, j, (current_player + 1)%2)) || (m != i && board[m][j] != nullptr))
-                  {
-                    can_castle = false;
-                    break;
-                  }
-                  m--;
-                }
-            }
-            if (can_castle)
-            {
-              moves.push_back(MyMove(file, rank, file + (inc ? 2 : -2), rank+rd, 0, "Castle"));
-            }
-          }
-        }
+  // All moves  must be validated such that
+  //    they do not put their own king into check
+  const U64 pins = pinned();
+  const bool check = in_check();
+  moves.erase(std::remove_if(moves.begin(), moves.end(), [&](const MyMove& action)
+  {
+    return exposes_king(action, pins, check);
+  }), moves.end());
+  std::shuffle(moves.begin(), moves.end(), shuffle_generator());
 
-      }
-      else if (type == &QUEEN)
-      {
-        // Queens can move any number of spaces in any direction if
-        //    there are no pieces between the Queen and the target square,
-        //    the target square is not a piece owned by the player
-        for (auto direction: KING_MOVES)
-        {
-          for (int r = 1; r < 8; r++)
-          {
-            int fd = direction.first; int rd = direction.second;
-            if (!iB(i+fd*r) || !iB(j+rd*r))
-              break;
-            auto *newloc = board[i+fd*r][j+rd*r];
-            if (newloc == nullptr)
-              moves.push_back(MyMove(file, rank, file+fd*r, rank+rd*r));
-            else 
-            {
-              if (newloc->owner != current_player)
-                moves.push_back(MyMove(file, rank, file+fd*r, rank+rd*r, newloc->type));
-              break;
-            }
-          }
-        }
-      }
-      else if (type == &KNIGHT)
-      {
-        // Knights can move in an L shape if
-        //    the target square is not a piece owned by the player
-        for (auto direction: KNIGHT_MOVES)
-        {
-          int fd = direction.first; int rd = direction.second;
-          if (!iB(i+fd) || !iB(j+rd))
-            continue;
-          auto *newloc = board[i+fd][j+rd];
-          if (newloc == nullptr || newloc->owner != current_player)
-            moves.push_back(MyMove(file, rank, file+fd, rank+rd, newloc == nullptr ? nullptr : newloc->type));
-        }
-      }
-      else if (type == &ROOK)
-      {
-        // Rooks can move any number of spaces across a rank or file if
-        //    there are no pieces between the rook and the target square,
-        //    the target square is not a piece owned by the player
-        for (auto direction: ROOK_MOVES)
-        {
-          for (int r = 1; r < 8; r++)
-          {
-            int fd = direction.first; int rd = direction.second;
-            if (!iB(i+fd*r) || !iB(j+rd*r))
-              break;
-            auto *newloc = board[i+fd*r][j+rd*r];
-            if (newloc == nullptr)
-              moves.push_back(MyMove(file, rank, file+fd*r, rank+rd*r));
-            else 
-            {
-              if (newloc->owner != current_player)
-                moves.push_back(MyMove(file, rank, file+fd*r, rank+rd*r, newloc->type));
-              break;
-            }
-          }
-        }
-      }
-      else if (type == &BISHOP)
-      {
-        // Bishops can move diagonally if
-        //    there are no pieces between the bishop and the target
-        //    the target square is not a piece owned by the player
-        for (auto direction: BISHOP_MOVES)
-        {
-          for (int r = 1; r < 8; r++)
-          {
-            int fd = direction.first; int rd = direction.second;
-            if (!iB(i+fd*r) || !iB(j+rd*r))
-              break;
-            auto *newloc = board[i+fd*r][j+rd*r];
-            if (newloc == nullptr)
-              moves.push_back(MyMove(file, rank, file+fd*r, rank+rd*r));
-            else 
-            {
-              if (newloc->owner != current_player)
-                moves.push_back(MyMove(file, rank, file+fd*r, rank+rd*r, newloc->type));
-              break;
-            }
-          }
-        }
-      }
+  // Now order captures to be first
 
-      // If one of them was valid, return it
-      for (int i = 0; i < moves.size(); i++)
-      {
-        if (in_check(moves[i]))
-        {
-          moves.erase(moves.begin() + i);
-          i--;
-        }
-        else
-          return true;
-      }
+  int k = 0;
+  for (int i = 0; i < static_cast<int>(moves.size()) - k; i++)
+  {
+    if (moves[i].capture != NO_PIECE)
+    {
+      moves.push_back(moves[i]);
+      moves.erase(moves.begin() + i);
+      i--;
+      k++;
     }
   }
 
-  return false;
+  std::reverse(moves.begin(), moves.end());
+
+  return moves;
 }
 
-State State::RESULT(const MyMove& action) const
+bool State::actions_exist()
 {
-  int file = action.file - 'a';
-  int rank = action.rank - 1;
-  int file2 = action.file2 - 'a';
-  int rank2 = action.rank2 - 1;
+  return (current_player ? any_legal<true>() : any_legal<false>());
+}
 
-  MyPiece *oldPiece = board[file][rank];
-  
+State State::RESULT(const MyMove& action) const
+{
   State result(*this);
-  
-  delete result.board[file2][rank2];
-  result.board[file2][rank2] = new MyPiece((action.promotion != nullptr ? action.promotion : oldPiece->type), true, oldPiece->owner);
-
-  delete result.board[file][rank];
-  result.board[file][rank] = nullptr;
-
-  if (action.move_type == "En Passant")
-  {
-    delete result.board[file2][rank];
-    result.board[file2][rank] = nullptr;
-  }
-  else if (action.move_type == "Castle")
-  {
-    MyPiece *castle = new MyPiece(&ROOK, true, oldPiece->owner);
-    int new_rank = (rank2 == 1 ? 2 : 5);
-    result.board[file2][new_rank] = castle;
-  }
-
-  result.current_player = (current_player + 1) % 2;
+  auto preserved = result.APPLY(action);
+  // The copy owns what the move displaced
+  for (auto pr: preserved)
+    delete pr.second;
   return result;
 }
 
@@ -856,77 +876,92 @@ std::vector<std::pair<pair, MyPiece*>> State::APPLY(const MyMove& action)
   int rank2 = action.rank2 - 1;
 
   // Apply the new board state
-  MyPiece *oldPiece = board[file][rank];  
+  MyPiece *oldPiece = board[file][rank];
   std::vector<std::pair<pair, MyPiece*>> preserved;
 
+  // Remember the position being left and reset the clock on pawn moves and captures
+  past_keys.push_back(key);
+  past_irreversible.push_back(Irreversible{castling, en_passant, last_capture});
+  bool en_passant_capture = (action.move_type == "En Passant");
+  last_capture = (oldPiece->type == PAWN || board[file2][rank2] != nullptr ? 0 : last_capture + 1);
+
   preserved.push_back(std::pair<pair, MyPiece*>(pair(file2, rank2), board[file2][rank2]));
-  board[file2][rank2] = new MyPiece((action.promotion != nullptr ? action.promotion: oldPiece->type), true, oldPiece->owner);
+  board[file2][rank2] = new MyPiece((action.promotion != NO_PIECE ? action.promotion : oldPiece->type), true, oldPiece->owner);
 
   preserved.push_back(std::pair<pair, MyPiece*>(pair(file, rank), board[file][rank]));
   board[file][rank] = nullptr;
 
-  if (action.move_type == "En Passant")
+  if (en_passant_capture)
   {
     preserved.push_back(std::pair<pair, MyPiece*>(pair(file2, rank), board[file2][rank]));
     board[file2][rank] = nullptr;
   }
   else if (action.move_type == "Castle")
   {
-    MyPiece *castle = new MyPiece(&ROOK, true, oldPiece->owner);
-    int new_rank = (rank2 == 1 ? 2 : 5);
-    int old_rank = (rank2 == 1 ? 0 : 7);
-    preserved.push_back(std::pair<pair, MyPiece*>(pair(file2, old_rank), board[file2][old_rank]));
-    preserved.push_back(std::pair<pair, MyPiece*>(pair(file2, new_rank), nullptr));
-    board[file2][old_rank] = nullptr;
-    board[file2][new_rank] = castle;
+    // The rook jumps from the corner to the tile the king passed over
+    int old_file = (file2 > file ? 7 : 0);
+    int new_file = (file2 > file ? 5 : 3);
+    preserved.push_back(std::pair<pair, MyPiece*>(pair(old_file, rank), board[old_file][rank]));
+    preserved.push_back(std::pair<pair, MyPiece*>(pair(new_file, rank), board[new_file][rank]));
+    board[old_file][rank] = nullptr;
+    board[new_file][rank] = new MyPiece(ROOK, true, oldPiece->owner);
   }
 
+  // Every changed tile is in preserved, so hash and update the bitboards by the difference
+  for (auto pr: preserved)
+  {
+    pair loc = pr.first;
+    key ^= zobrist(pr.second, loc.first, loc.second) ^ zobrist(board[loc.first][loc.second], loc.first, loc.second);
+    toggle(pr.second, loc.first, loc.second);
+    toggle(board[loc.first][loc.second], loc.first, loc.second);
+  }
+
+  // Moving the king or a rook, or capturing a rook, gives up castling on that side
+  key ^= ZOBRIST_CASTLING[castling] ^ zobrist_en_passant(en_passant);
+  castling &= ~(castle_mask(file, rank) | castle_mask(file2, rank2));
+
   current_player = !current_player;
-  
+
+  // A double pawn push allows en passant on the tile it passed over
+  en_passant = -1;
+  if (oldPiece->type == PAWN && abs(rank2 - rank) == 2 && en_passant_capturable(file + 8 * ((rank + rank2) / 2)))
+    en_passant = file + 8 * ((rank + rank2) / 2);
+
+  key ^= ZOBRIST_CASTLING[castling] ^ zobrist_en_passant(en_passant) ^ ZOBRIST_SIDE;
+
   return preserved;
-  
+
 }
 
-void State::UNDO(const MyMove& action, std::vector<std::pair<pair, MyPiece*>> preserved)
+void State::UNDO(const std::vector<std::pair<pair, MyPiece*>>& preserved)
 {
   // Restore the board to its original state
 
   current_player = !current_player;
-  
+
   for (auto pr: preserved)
   {
     pair loc = pr.first;
-    MyPiece* orig = pr.second;
+    toggle(board[loc.first][loc.second], loc.first, loc.second);
+    toggle(pr.second, loc.first, loc.second);
     delete board[loc.first][loc.second];
-    board[loc.first][loc.second] = orig;
+    board[loc.first][loc.second] = pr.second;
   }
+
+  key = past_keys.back();
+  past_keys.pop_back();
+  const Irreversible& before = past_irreversible.back();
+  castling = before.castling;
+  en_passant = before.en_passant;
+  last_capture = before.last_capture;
+  past_irreversible.pop_back();
 }
 
 bool State::in_check() const
 {
-  // Find the king
-  int ki, kj;
-  bool found=false;
-
-  for (int i = 0; i < 8; i++)
-  {
-    if (found)
-      break;
-    for (int j = 0; j < 8; j++)
-    {
-      MyPiece* p = board[i][j];
-      if (p != nullptr && p->type == &KING && p->owner == current_player)
-      {
-        ki = i;
-        kj = j;
-        found = true;
-        break;
-      }
-    }
-  }
-
   // Check if the king is in check
-  return in_check(ki, kj, (current_player + 1) % 2);
+  int king = lsb(pieces[current_player][KING]);
+  return (current_player ? attackers<false>(king) : attackers<true>(king)) != 0;
 }
 
 bool State::in_check(const MyMove& action)
@@ -937,7 +972,7 @@ bool State::in_check(const MyMove& action)
   bool check = in_check();
   current_player = !current_player;
   
-  UNDO(action, preserved);
+  UNDO(preserved);
 
   return check;
 }
@@ -953,12 +988,12 @@ bool State::stalemate() const
       auto *piece = board[i][j];
       if (piece == nullptr)
         continue;
-      if (piece->type == &PAWN || piece->type == &ROOK)
+      if (piece->type == PAWN || piece->type == ROOK || piece->type == QUEEN)
       {
         mats = 2;
         break;
       }
-      else if (piece->type == &BISHOP || piece->type == &KNIGHT)
+      else if (piece->type == BISHOP || piece->type == KNIGHT)
       {
         mats++;
         if (mats > 1)
@@ -970,24 +1005,46 @@ bool State::stalemate() const
     return true;
 
   // 50-move rule
+  if (last_capture >= 100)
+    return true;
 
-  // 4-fold repetition
+  // Threefold repetition
+  if (repetitions() >= 2)
+    return true;
 
   return false;
 }
 
-int State::goal_reached(const Game& game)
+int State::repetitions() const
 {
-  if (!actions_exist(game))
+  // Only positions with the same player to move and inside the reversible window can match
+  int count = 0;
+  int n = past_keys.size();
+  for (int k = n - 2; k >= 0 && n - k <= last_capture; k -= 2)
+  {
+    if (past_keys[k] == key)
+      count++;
+  }
+  return count;
+}
+
+bool State::draw_by_rule() const
+{
+  return last_capture >= 100 || repetitions() > 0;
+}
+
+int State::goal_reached()
+{
+  if (!actions_exist())
   {
     if (in_check())
     {
-      return -1000000 * (game->current_turn % 2 == current_player ? 1 : -1); // Checkmate
+      return -1000000 * (root_player == current_player ? 1 : -1); // Checkmate
     }
-    return -1000; // Draw
+    return DRAW;
   }
   if (stalemate())
-    return -1000;
+    return DRAW;
   return 0; // Not a goal
 }
 
@@ -1006,27 +1063,39 @@ int State::material_advantage(bool maxPlayer)
   return advantage;
 }
 
-float State::evaluate(const Game& game)
+float State::evaluate()
 {
-  int goal = goal_reached(game);
+  int goal = goal_reached();
   if (goal != 0)
     return goal;
-  return material_advantage(game->current_turn % 2);
+
+  // Three-piece endings are known exactly; a won one is scored by how close the win is
+  WDL wdl;
+  if (BITBASES.probe(*this, wdl))
+  {
+    if (wdl == WDL_DRAW)
+      return DRAW;
+    bool winner = (wdl == WDL_WIN ? current_player : !current_player);
+    int score = KNOWN_WIN + std::abs(material_advantage(winner)) + winning_progress(winner);
+    return (winner == root_player ? score : -score);
+  }
+
+  return material_advantage(root_player);
 }
 
-int State::value(const char* pieceType) const
+int State::winning_progress(bool winner) const
 {
-  if (pieceType == &PAWN)
-    return 1;
-  else if (pieceType == &ROOK)
-    return 5;
-  else if (pieceType == &BISHOP)
-    return 3;
-  else if (pieceType == &KNIGHT)  
-    return 3;
-  else if (pieceType == &QUEEN)
-    return 9;
-  return 0;
+  int king = lsb(pieces[winner][KING]);
+  int loser = lsb(pieces[!winner][KING]);
+  int edge = std::max(3 - loser % 8, loser % 8 - 4) + std::max(3 - loser / 8, loser / 8 - 4);
+  int apart = std::max(std::abs(king % 8 - loser % 8), std::abs(king / 8 - loser / 8));
+  int progress = 10 * edge + 10 * (7 - apart);
+  if (pieces[winner][PAWN])
+  {
+    int rank = lsb(pieces[winner][PAWN]) / 8;
+    progress += 20 * (winner == 0 ? rank : 7 - rank);
+  }
+  return progress;
 }
 
 void State::print() const
@@ -1040,13 +1109,49 @@ void State::print() const
       if (board[j][i] == nullptr)
         std::cout << "  ";
       else
-        std::cout << unicode((char)(board[j][i]->owner == 0 ? (*(board[j][i]->type)) : std::tolower(*(board[j][i]->type)))) << " ";
+        std::cout << GLYPHS[board[j][i]->owner][board[j][i]->type] << " ";
     }
     std::cout << WHITE_FG << "|" << std::endl;
   }
   std::cout << "  +----------------+\n" << "    a b c d e f g h" << std::endl << std::endl;
 }
 
+int State::piece_count() const
+{
+  return popcount(occupied[0] | occupied[1]);
+}
+
+void State::toggle(const MyPiece* piece, int i, int j)
+{
+  if (piece == nullptr)
+    return;
+  U64 tile = 1ULL << (i + 8 * j);
+  pieces[piece->owner][piece->type] ^= tile;
+  occupied[piece->owner] ^= tile;
+}
+
+void State::compute_bitboards()
+{
+  for (int owner = 0; owner < 2; owner++)
+  {
+    occupied[owner] = 0;
+    for (int type = 0; type < 6; type++)
+      pieces[owner][type] = 0;
+  }
+  for (int i = 0; i < 8; i++)
+    for (int j = 0; j < 8; j++)
+      toggle(board[i][j], i, j);
+}
+
+U64 State::compute_key() const
+{
+  U64 k = (current_player ? ZOBRIST_SIDE : 0) ^ ZOBRIST_CASTLING[castling] ^ zobrist_en_passant(en_passant);
+  for (int i = 0; i < 8; i++)
+    for (int j = 0; j < 8; j++)
+      k ^= zobrist(board[i][j], i, j);
+  return k;
+}
+
 const MyPiece* State::getPiece(const char& file, const int& rank) const
 {
   return board[static_cast<int>(file - 'a')][rank - 1];
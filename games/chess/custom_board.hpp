@@ -7,13 +7,11 @@
 #ifndef CUSTOM_BOARD_HPP
 #define CUSTOM_BOARD_HPP
 
-#include "impl/chess.hpp"
-#include "game.hpp"
-#include "game_object.hpp"
-#include "move.hpp"
-#include "piece.hpp"
-#include "player.hpp"
+#include "impl/chess_fwd.hpp"
 #include <algorithm>
+#include <cstdint>
+#include <string>
+#include <vector>
 
 typedef unsigned long long U64;
 
@@ -25,45 +23,66 @@ namespace chess
 // Ordered pair to represent (file, rank) or (file_direction, rank_direction)
 using pair = std::pair<int, int>;
 
-// Left and right (or backward and forward)
-const int LR[2] = {-1, 1};
-
-
 // Color combinations for board visualization
 const char WHITE_FG[] = "\033[0;39m";
 const char BLACK_BG[] = "\033[40m";
 const char WHITE_BG[] = "\033[100m";
 
-// Character representation of pieces
-const char KING = 'K';
-const char QUEEN = 'Q';
-const char KNIGHT = 'N';
-const char BISHOP = 'B';
-const char ROOK = 'R';
-const char PAWN = 'P';
-
-// Move directions available to units
-const std::vector<pair> PAWN_ATTACKS[2] = {{pair(1, 1), pair(-1, 1)}, {pair(1, -1), pair(-1, -1)}};
-const std::vector<pair> KNIGHT_MOVES = {pair(2, 1), pair(2, -1), pair(-2, 1), pair(-2, -1), pair(1, 2), pair(1, -2), pair(-1, 2), pair(-1, -2)};
-const std::vector<pair> KING_MOVES = {pair(-1, -1), pair(-1, 0), pair(-1, 1), pair(0, -1), pair(0, 1), pair(1, -1), pair(1, 0), pair(1, 1)};
-const std::vector<pair> ROOK_MOVES = {pair(-1, 0), pair(0, -1), pair(0, 1), pair(1, 0)};
-const std::vector<pair> BISHOP_MOVES = {pair(-1, -1), pair(-1, 1), pair(1, -1), pair(1, 1)};
-const std::vector<pair> CASTLING = {{pair(-4, 0), pair(3, 0)}};
-
-// Convert from the shortened single character to the piece's full type
-std::string lengthen(const char* name);
+// Piece types, numbered as the indices into ZOBRIST_PIECES, State's bitboards and the tables below
+//      NO_PIECE marks a move that captures or promotes to nothing
+enum PieceType : uint8_t { PAWN, KNIGHT, BISHOP, ROOK, QUEEN, KING, NO_PIECE };
+
+// FEN symbol of each player's pieces: PIECE_SYMBOLS[owner][type]
+const char PIECE_SYMBOLS[2][7] = {"PNBRQK", "pnbrqk"};
+
+// The framework's name of each piece type
+const char* const PIECE_NAMES[7] = {"Pawn", "Knight", "Bishop", "Rook", "Queen", "King", ""};
+
+// Material value of each piece type; the king and NO_PIECE are worth nothing
+const int PIECE_VALUES[7] = {1, 3, 3, 5, 9, 0, 0};
+
+// Value of a drawn state
+const int DRAW = -1000;
+
+// Value of a won bitbase ending before its progress terms; more than any material, less than a mate
+const int KNOWN_WIN = 5000;
+
+// The piece type with the given FEN symbol, of either case, or NO_PIECE if there is none
+PieceType piece_from_symbol(char symbol);
+
+// Zobrist keys for hashing board states
+//      ZOBRIST_PIECES[owner][piece][file][rank] is xor'd in for each occupied tile
+//      ZOBRIST_SIDE is xor'd in when black is to move
+//      ZOBRIST_CASTLING[rights] is xor'd in for the castling rights bitmask
+//      ZOBRIST_EN_PASSANT[file] is xor'd in when an en passant capture is available on that file
+//      ZOBRIST_ROOT is xor'd in by perspective_hash() when the evaluation favors black
+extern U64 ZOBRIST_PIECES[2][6][8][8];
+extern U64 ZOBRIST_SIDE;
+extern U64 ZOBRIST_CASTLING[16];
+extern U64 ZOBRIST_EN_PASSANT[8];
+extern U64 ZOBRIST_ROOT;
+
+// Castling rights bits: {white kingside, white queenside, black kingside, black queenside}
+const int CASTLE_RIGHTS[2][2] = {{1, 2}, {4, 8}};
+
+// Kinds of moves the move generator can be limited to
+//      CAPTURES: captures, en passant and promotions
+//      QUIETS: every other move, including castling
+//      EVASIONS: moves that may get out of check; only valid when in check
+//      ALL: CAPTURES and QUIETS
+enum GenType { CAPTURES, QUIETS, EVASIONS, ALL };
 
 ////////////////////////////////////////////////////////////////////// 
 /// @class MyPiece 
 /// @brief A Chess game piece
 ////////////////////////////////////////////////////////////////////// 
 struct MyPiece {
-    const char* type; // The piece type: {"King", "Queen", "Knight", "Rook", "Bishop", "Pawn"}
+    PieceType type; // The piece type; never NO_PIECE
     bool has_moved; // Whether this piece has already moved in this game
     bool owner; // Who owns this piece: {0 for white, 1 for black}
 
     // Constructor for MyPiece
-    MyPiece(const char* _type, const bool _has_moved, const bool _owner) : type(_type), has_moved(_has_moved), owner(_owner) {};
+    MyPiece(PieceType _type, const bool _has_moved, const bool _owner) : type(_type), has_moved(_has_moved), owner(_owner) {};
 };
 
 ////////////////////////////////////////////////////////////////////// 
@@ -75,20 +94,34 @@ struct MyMove {
     int rank; // The starting rank
     char file2; // The target file
     int rank2; // The target rank
-    const char* capture; // The piece type being captured
-    const char* promotion; // The piece to promote to, for pawns at the final rank
+    PieceType capture; // The piece type being captured, or NO_PIECE
+    PieceType promotion; // The piece to promote to, for pawns at the final rank, or NO_PIECE
     std::string move_type; // Used to indicate special moves: {"En Passant", "Castle", "Move", "None"}
 
     // Constructor for MyMove
-    MyMove() : move_type("None") {};
-    MyMove(char startingFile, int startingRank, char targetFile, int targetRank, const char* capture_=0, const char* promotion_=0, std::string _move_type = "Move"): rank(startingRank), file(startingFile), rank2(targetRank), file2(targetFile), capture(capture_), promotion(promotion_), move_type(_move_type) {};
+    MyMove() : file('a'), rank(1), file2('a'), rank2(1), capture(NO_PIECE), promotion(NO_PIECE), move_type("None") {};
+    MyMove(char startingFile, int startingRank, char targetFile, int targetRank, PieceType capture_=NO_PIECE, PieceType promotion_=NO_PIECE, std::string _move_type = "Move"): rank(startingRank), file(startingFile), rank2(targetRank), file2(targetFile), capture(capture_), promotion(promotion_), move_type(_move_type) {};
 
     std::string hash() const
     {
         return file + std::to_string(rank) + file2 + std::to_string(rank2);
     };
+
+    // Compact encoding for tables: starting tile | target tile << 6 | promotion << 12
+    //      Tiles are numbered file + 8 * rank from a1 = 0; the default move encodes to 0
+    uint16_t id() const;
+
+    // The starting and target tiles, numbered as in id()
+    int from() const { return (file - 'a') + 8 * (rank - 1); }
+    int to() const { return (file2 - 'a') + 8 * (rank2 - 1); }
+
+    // Coordinate notation, e.g. "e2e4" or "e7e8q"
+    std::string uci() const;
 };
 
+// Coordinate notation of a move encoded by MyMove::id()
+std::string uci_from_id(uint16_t id);
+
 
 
 ////////////////////////////////////////////////////////////////////// 
@@ -99,7 +132,79 @@ class State {
   private:
     MyPiece ***board; // A 2d board, containing pointers to Chess pieces
     bool current_player; // The player whose turn it is to make a move: {0 white, 1 black}
+    bool root_player; // The player the evaluation favors; by default the player to move when constructed
+    int castling; // Castling rights still available, as CASTLE_RIGHTS bits
+    int en_passant; // Tile a pawn may capture onto en passant, numbered as in MyMove::id(), or -1
     int last_capture; // The number of moves since the last pawn move or piece capture
+    int root_ply; // Plies played in the game before this State was constructed
+    U64 key; // Zobrist hash of the board, the player to move, castling rights and en passant
+    U64 pieces[2][6]; // Tiles of each player's pieces of each type, indexed as ZOBRIST_PIECES
+    U64 occupied[2]; // Tiles of each player's pieces
+    std::vector<U64> past_keys; // Hashes of the earlier positions, oldest first
+
+    // What APPLY cannot recompute when undoing a move
+    struct Irreversible {
+        int castling;
+        int en_passant;
+        int last_capture;
+    };
+    std::vector<Irreversible> past_irreversible; // Saved before each applied move
+
+    // Construct an empty board
+    State();
+
+    // Recompute the Zobrist hash from scratch
+    U64 compute_key() const;
+
+    // Recompute the bitboards from board
+    void compute_bitboards();
+
+    // Add or remove a piece at board[i][j] from the bitboards; nullptr is ignored
+    void toggle(const MyPiece* piece, int i, int j);
+
+    // Tiles of Attacker's pieces that attack tile sq
+    template <bool Attacker>
+    U64 attackers(int sq) const;
+
+    // Whether the tile at board[i][j] is attacked by a piece of Attacker's
+    template <bool Attacker>
+    bool attacked(int i, int j) const;
+
+    // Append a move from board[i][j] to each tile of targets
+    void add_moves(int i, int j, U64 targets, std::vector<MyMove>& moves) const;
+
+    // Append the pseudo-legal moves of Us's piece at board[i][j] to moves, limited to Type
+    template <bool Us, GenType Type>
+    void piece_moves(int i, int j, std::vector<MyMove>& moves);
+
+    // Append the pseudo-legal moves of every piece of Us's to moves, limited to Type
+    template <bool Us, GenType Type>
+    void generate(std::vector<MyMove>& moves);
+
+    // Drop the moves that cannot get Us out of check: in double check everything but
+    // king moves, else moves that neither capture the checker nor block its line
+    template <bool Us>
+    void keep_evasions(std::vector<MyMove>& moves) const;
+
+    // Whether Us has a legal move; stops at the first one found
+    template <bool Us>
+    bool any_legal();
+
+    // Pieces of the player to move that are the only piece between their king and an enemy slider
+    U64 pinned() const;
+
+    // Whether a pseudo-legal move of the player to move leaves their king attacked
+    //      Out of check only king moves, en passant and pinned pieces can, so only those are played out
+    // Parameters:
+    //      U64 pins: pinned() for the current position
+    //      bool check: in_check() for the current position
+    bool exposes_king(const MyMove& action, U64 pins, bool check);
+
+    // Whether the player to move has a pawn that can capture onto the en passant tile
+    bool en_passant_capturable(int tile) const;
+
+    // Seed past_keys from the game's move list
+    void seed_history(const Game& game);
 
   public:
     // Determine whether the target rank and file are in check by attacker
@@ -125,22 +230,61 @@ class State {
     // Determines whether the given state is a draw
     bool stalemate() const;
 
+    // Number of earlier occurrences of the current position since the last irreversible move
+    int repetitions() const;
+
+    // Number of moves since the last pawn move or piece capture
+    int halfmove_clock() const { return last_capture; }
+
+    // Castling rights still available, as CASTLE_RIGHTS bits
+    int castling_rights() const { return castling; }
+
+    // Tile the player to move may capture onto en passant, numbered as in MyMove::id(), or -1
+    int en_passant_tile() const { return en_passant; }
+
+    // Number of pieces on the board, kings included
+    int piece_count() const;
+
+    // Tiles of a player's pieces of a type, numbered as in MyMove::id()
+    U64 pieces_of(bool owner, PieceType type) const { return pieces[owner][type]; }
+
+    // Determines whether the line leading here should be scored as a draw;
+    //      stricter than stalemate() in that a single repetition is enough
+    bool draw_by_rule() const;
+
     // Determines whether the state is an end state; i.e. a stalemate or checkmate occurred
-    int goal_reached(const Game& game);
+    int goal_reached();
 
     // Material advantage of the current state
     int material_advantage(bool maxPlayer);
 
-    // Perform heuristic on current state
-    float evaluate(const Game& game);
+    // Perform heuristic on current state, from the perspective of root_player
+    float evaluate();
+
+    // Progress of the winner toward mate or promotion in a won bitbase ending:
+    //      the loser's king driven to the edge, the kings close together and the pawn advanced
+    int winning_progress(bool winner) const;
 
     // Value of piece types
-    int value(const char* pieceType) const;
+    int value(PieceType pieceType) const { return PIECE_VALUES[pieceType]; }
 
 
     // Construct the State from the MMAI framework game state
+    //      The position is parsed from the game's FEN and the earlier positions
+    //      from its move list, so the State may be searched while the framework
+    //      updates the game
     State(const Game &game);
 
+    // Construct a State from Forsyth-Edwards Notation
+    //      The castling, en passant, halfmove and fullmove fields are optional
+    // Throws std::invalid_argument if the FEN cannot be parsed or describes an illegal position
+    static State from_fen(const std::string& fen);
+
+    // Forsyth-Edwards Notation of the current state
+    //      En passant is only written when a capture is possible, so the
+    //      result may differ from the FEN the State was built from in that field
+    std::string to_fen() const;
+
     // State copy constructor
     State(const State &original);
     
@@ -148,19 +292,21 @@ class State {
     ~State();
 
     // Determines whether a state is quiescent or not
-    bool quiescent(const Game &game);
+    bool quiescent();
 
     // Move Generator
     // Parameters:
-    //      Game& game: The current game state; used to retrieve previous moves
+    //      GenType type: Which moves to generate; ALL generates EVASIONS when in check
     // Returns a vector of moves specifying which actions can be taken from the current state
-    std::vector<MyMove> ACTIONS(const Game &game);
+    std::vector<MyMove> ACTIONS(GenType type = ALL);
+
+    // Seed the calling thread's generator for ACTIONS' shuffling of equal moves
+    //      Each thread has its own generator, seeded randomly until this is called
+    static void seed_shuffle(unsigned seed);
 
     // Reduced Move Generator
-    // Parameters:
-    //      Game& game: The current game state; used to retrieve previous moves
     // Returns true if moves exist from the state, else false
-    bool actions_exist(const Game &game);
+    bool actions_exist();
 
     // Successor generator
     // Parameters:
@@ -172,11 +318,25 @@ class State {
     std::vector<std::pair<pair, MyPiece*>> APPLY(const MyMove& action);
 
     // Undoes a move
-    void UNDO(const MyMove& action, std::vector<std::pair<pair, MyPiece*>>);
+    void UNDO(const std::vector<std::pair<pair, MyPiece*>>& preserved);
 
     // Display the current game state
     void print() const;
 
+    // Zobrist hash of the current state, maintained incrementally by APPLY and UNDO
+    U64 hash() const { return key; }
+
+    // Zobrist hash that also tells apart which player the evaluation favors;
+    //      used for tables of evaluations and search results
+    U64 perspective_hash() const { return key ^ (root_player ? ZOBRIST_ROOT : 0); }
+
+    // The player whose turn it is: {0 white, 1 black}
+    bool player_to_move() const { return current_player; }
+
+    // The player the evaluation favors
+    bool get_root_player() const { return root_player; }
+    void set_root_player(bool player) { root_player = player; }
+
     // Get the piece at the given file and rank
     // file and rank are in SAN, where file [a,h] and rank [1,8]
     const MyPiece* getPiece(const char& file,const int& rank) const;
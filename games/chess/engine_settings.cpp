@@ -0,0 +1,47 @@
+//////////////////////////////////////////////////////////////////////
+/// @file engine_settings.cpp
+/// @author Shawn McCormick CS5400
+/// @brief The engine's --aiSettings keys and their parsed values
+//////////////////////////////////////////////////////////////////////
+
+#include "engine_settings.hpp"
+
+#include <cstdlib>
+
+namespace cpp_client
+{
+
+namespace chess
+{
+
+EngineSettings::EngineSettings()
+  : ponder(true), book_best(false), probe(true), depth(20), quiescence(3)
+{
+}
+
+bool EngineSettings::set(const std::string& key, const std::string& value)
+{
+  if (key == "ponder")
+    ponder = (value != "0");
+  else if (key == "stats")
+    stats = value;
+  else if (key == "book")
+    book = value;
+  else if (key == "book_pick")
+    book_best = (value == "best");
+  else if (key == "bitbases")
+    bitbases = value;
+  else if (key == "tb")
+    probe = (value != "0");
+  else if (key == "depth")
+    depth = std::atoi(value.c_str());
+  else if (key == "quiescence")
+    quiescence = std::atoi(value.c_str());
+  else
+    return false;
+  return true;
+}
+
+}
+
+}
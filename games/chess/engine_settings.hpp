@@ -0,0 +1,51 @@
+//////////////////////////////////////////////////////////////////////
+/// @file engine_settings.hpp
+/// @author Shawn McCormick CS5400
+/// @brief The engine's --aiSettings keys and their parsed values
+//////////////////////////////////////////////////////////////////////
+
+#ifndef ENGINE_SETTINGS_HPP
+#define ENGINE_SETTINGS_HPP
+
+#include <string>
+
+namespace cpp_client
+{
+
+namespace chess
+{
+
+// Every key EngineSettings::set() understands
+const char* const ENGINE_SETTING_KEYS[] = {
+    "ponder", "stats", "book", "book_pick", "bitbases", "tb", "depth", "quiescence"};
+
+//////////////////////////////////////////////////////////////////////
+/// @class EngineSettings
+/// @brief One engine's configuration, as given with --aiSettings
+///
+/// The client reads each of ENGINE_SETTING_KEYS from its settings and
+/// the arena reads them from a settings string, so both set up an
+/// engine the same way. Keys that are not given keep their defaults.
+//////////////////////////////////////////////////////////////////////
+struct EngineSettings {
+    bool ponder; // ponder=0 turns off thinking on the opponent's time
+    std::string stats; // stats=<file>: append each turn's search statistics as JSON lines
+    std::string book; // book=<file>: a Polyglot book to play from
+    bool book_best; // book_pick=best: play the book's heaviest move instead of a weighted random one
+    std::string bitbases; // bitbases=<file>: where the bitbases are cached between runs
+    bool probe; // tb=0 turns off endgame table probing in the search
+    int depth; // depth=<plies>: the deepest iteration searched
+    int quiescence; // quiescence=<n>: quiescence depth increases allowed
+
+    EngineSettings();
+
+    // Apply one setting
+    // Returns false if the key is not one of ENGINE_SETTING_KEYS
+    bool set(const std::string& key, const std::string& value);
+};
+
+}
+
+}
+
+#endif
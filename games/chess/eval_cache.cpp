@@ -0,0 +1,77 @@
+////////////////////////////////////////////////////////////////////// 
+/// @file eval_cache.cpp 
+/// @author Shawn McCormick CS5400
+/// @brief Implementation of the static evaluation cache
+////////////////////////////////////////////////////////////////////// 
+
+#include "eval_cache.hpp"
+#include "custom_board.hpp"
+
+#include <cstdint>
+#include <cstring>
+
+namespace cpp_client
+{
+
+namespace chess
+{
+
+EvalCache::EvalCache(int size_log2) : table(new Entry[1ULL << size_log2]), mask((1ULL << size_log2) - 1)
+{
+  clear();
+}
+
+bool EvalCache::probe(U64 key, float& value)
+{
+  probe_count.fetch_add(1, std::memory_order_relaxed);
+
+  Entry& entry = table[key & mask];
+  U64 data = entry.data.load(std::memory_order_relaxed);
+  U64 check = entry.check.load(std::memory_order_relaxed);
+  if ((check ^ data) != key)
+    return false;
+
+  uint32_t bits = static_cast<uint32_t>(data);
+  std::memcpy(&value, &bits, sizeof(value));
+  hit_count.fetch_add(1, std::memory_order_relaxed);
+  return true;
+}
+
+void EvalCache::store(U64 key, float value)
+{
+  uint32_t bits;
+  std::memcpy(&bits, &value, sizeof(bits));
+  U64 data = bits;
+
+  Entry& entry = table[key & mask];
+  entry.data.store(data, std::memory_order_relaxed);
+  entry.check.store(key ^ data, std::memory_order_relaxed);
+}
+
+float EvalCache::evaluate(State& state)
+{
+  // State::evaluate scores for the root player, so each perspective is cached separately
+  U64 key = state.perspective_hash();
+  float value;
+  if (probe(key, value))
+    return value;
+  value = state.evaluate();
+  store(key, value);
+  return value;
+}
+
+void EvalCache::clear()
+{
+  for (U64 i = 0; i <= mask; i++)
+  {
+    // An empty slot only validates for a key of all ones, which no position hashes to in practice
+    table[i].data.store(0, std::memory_order_relaxed);
+    table[i].check.store(~0ULL, std::memory_order_relaxed);
+  }
+  probe_count.store(0, std::memory_order_relaxed);
+  hit_count.store(0, std::memory_order_relaxed);
+}
+
+}
+
+}
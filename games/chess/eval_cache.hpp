@@ -0,0 +1,78 @@
+////////////////////////////////////////////////////////////////////// 
+/// @file eval_cache.hpp 
+/// @author Shawn McCormick CS5400
+/// @brief Direct-mapped cache of static evaluations keyed by Zobrist hash
+////////////////////////////////////////////////////////////////////// 
+
+#ifndef EVAL_CACHE_HPP
+#define EVAL_CACHE_HPP
+
+#include <atomic>
+#include <memory>
+
+typedef unsigned long long U64;
+
+namespace cpp_client
+{
+
+namespace chess
+{
+
+class State;
+
+////////////////////////////////////////////////////////////////////// 
+/// @class EvalCache 
+/// @brief Lock-free table of (key, static eval) pairs
+///
+/// Each slot stores the evaluation and the key xor'd with it, so a slot
+/// torn by two threads writing at once fails validation instead of
+/// returning another position's value. This lets every search thread
+/// share one cache without locking.
+////////////////////////////////////////////////////////////////////// 
+class EvalCache {
+  private:
+    struct Entry {
+        std::atomic<U64> check; // key ^ data
+        std::atomic<U64> data; // The evaluation's bits
+    };
+
+    std::unique_ptr<Entry[]> table; // The cache slots
+    U64 mask; // Number of slots - 1; used to map keys to slots
+
+    std::atomic<U64> probe_count; // Number of lookups performed
+    std::atomic<U64> hit_count; // Number of lookups that found their key
+
+  public:
+    // Construct a cache with 2^size_log2 slots
+    explicit EvalCache(int size_log2 = 18);
+
+    EvalCache(const EvalCache&) = delete;
+    EvalCache& operator=(const EvalCache&) = delete;
+
+    // Look up a key
+    // Parameters:
+    //      U64 key: The Zobrist hash of the position
+    //      float& value: Set to the cached evaluation on a hit
+    // Returns true if the key was found, else false
+    bool probe(U64 key, float& value);
+
+    // Store an evaluation, replacing whatever occupied the slot
+    void store(U64 key, float value);
+
+    // Evaluate a state, consulting the cache before State::evaluate
+    float evaluate(State& state);
+
+    // Empty every slot and reset the counters
+    void clear();
+
+    // Hit-rate counters
+    U64 probes() const { return probe_count.load(std::memory_order_relaxed); }
+    U64 hits() const { return hit_count.load(std::memory_order_relaxed); }
+    double hit_rate() const { return probes() == 0 ? 0 : static_cast<double>(hits()) / probes(); }
+};
+
+}
+
+}
+
+#endif
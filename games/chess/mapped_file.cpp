@@ -0,0 +1,74 @@
+//////////////////////////////////////////////////////////////////////
+/// @file mapped_file.cpp
+/// @author Shawn McCormick CS5400
+/// @brief Read-only memory mapping of a whole file
+//////////////////////////////////////////////////////////////////////
+
+#include "mapped_file.hpp"
+
+#include <fstream>
+#include <iterator>
+
+#ifndef _WIN32
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
+namespace cpp_client
+{
+
+namespace chess
+{
+
+bool MappedFile::open(const std::string& path)
+{
+  close();
+
+#ifndef _WIN32
+  int fd = ::open(path.c_str(), O_RDONLY);
+  if (fd < 0)
+    return false;
+  struct stat info;
+  if (fstat(fd, &info) != 0 || info.st_size == 0)
+  {
+    ::close(fd);
+    return false;
+  }
+  void* mapped = mmap(nullptr, info.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+  // The mapping holds its own reference to the file
+  ::close(fd);
+  if (mapped == MAP_FAILED)
+    return false;
+  bytes = static_cast<const unsigned char*>(mapped);
+  length = info.st_size;
+#else
+  std::ifstream file(path, std::ios::binary);
+  if (!file)
+    return false;
+  buffer.assign(std::istreambuf_iterator<char>(file), std::istreambuf_iterator<char>());
+  if (buffer.empty())
+    return false;
+  bytes = buffer.data();
+  length = buffer.size();
+#endif
+  return true;
+}
+
+void MappedFile::close()
+{
+  if (bytes == nullptr)
+    return;
+#ifndef _WIN32
+  munmap(const_cast<unsigned char*>(bytes), length);
+#else
+  buffer.clear();
+#endif
+  bytes = nullptr;
+  length = 0;
+}
+
+}
+
+}
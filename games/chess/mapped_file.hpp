@@ -0,0 +1,56 @@
+//////////////////////////////////////////////////////////////////////
+/// @file mapped_file.hpp
+/// @author Shawn McCormick CS5400
+/// @brief Read-only memory mapping of a whole file
+//////////////////////////////////////////////////////////////////////
+
+#ifndef MAPPED_FILE_HPP
+#define MAPPED_FILE_HPP
+
+#include <cstddef>
+#include <string>
+#include <vector>
+
+namespace cpp_client
+{
+
+namespace chess
+{
+
+//////////////////////////////////////////////////////////////////////
+/// @class MappedFile
+/// @brief A file's bytes, mapped with mmap
+///
+/// Pages are read in by the OS as they are touched, so large books and
+/// tables cost nothing until probed. Where mmap is unavailable the file
+/// is read into memory instead.
+//////////////////////////////////////////////////////////////////////
+class MappedFile {
+  private:
+    const unsigned char* bytes; // The mapped file, or nullptr when closed
+    std::size_t length; // Bytes mapped
+    std::vector<unsigned char> buffer; // The file's contents where mmap is unavailable
+
+  public:
+    MappedFile() : bytes(nullptr), length(0) {}
+    ~MappedFile() { close(); }
+    MappedFile(const MappedFile&) = delete;
+    MappedFile& operator=(const MappedFile&) = delete;
+
+    // Map a file, closing any file already open
+    // Returns false if the file cannot be opened or is empty
+    bool open(const std::string& path);
+
+    // Unmap the file
+    void close();
+
+    bool is_open() const { return bytes != nullptr; }
+    const unsigned char* data() const { return bytes; }
+    std::size_t size() const { return length; }
+};
+
+}
+
+}
+
+#endif
@@ -0,0 +1,130 @@
+////////////////////////////////////////////////////////////////////// 
+/// @file ponder.cpp 
+/// @author Shawn McCormick CS5400
+/// @brief Implementation of searching on the opponent's time
+////////////////////////////////////////////////////////////////////// 
+
+#include "ponder.hpp"
+
+namespace cpp_client
+{
+
+namespace chess
+{
+
+// Time allowed for predicting the opponent's reply, in seconds
+const double PREDICT_SOFT = 0.05;
+const double PREDICT_HARD = 0.1;
+
+Ponderer::~Ponderer()
+{
+  stop();
+}
+
+void Ponderer::start(const State& state, SearchTables& tables, EvalCache& cache, int max_depth, int quiescence_, uint16_t reply)
+{
+  stop();
+
+  position.reset(new State(state));
+  quiescence = quiescence_;
+  suggested = reply;
+  timer.start_infinite();
+  // Started here rather than by the worker, so a stop() from now on reaches the prediction too
+  predictor.start_fixed(PREDICT_SOFT, PREDICT_HARD);
+  prediction.tablebases = tables.tablebases;
+  {
+    std::lock_guard<std::mutex> guard(lock);
+    status = PONDERING;
+    predicted = false;
+  }
+  worker = std::thread(&Ponderer::run, this, std::ref(tables), std::ref(cache), max_depth);
+}
+
+void Ponderer::run(SearchTables& tables, EvalCache& cache, int max_depth)
+{
+  // Our principal variation already expects a reply; take it if it is legal
+  MyMove reply;
+  if (suggested != 0)
+  {
+    for (const MyMove& action : position->ACTIONS())
+      if (action.id() == suggested)
+        reply = action;
+  }
+
+  // Otherwise predict the opponent's reply by searching briefly from their side
+  if (reply.move_type == "None")
+  {
+    bool us = position->get_root_player();
+    position->set_root_player(position->player_to_move());
+    prediction.new_search();
+    reply = tliddlmm(*position, prediction, cache, predictor, max_depth, quiescence);
+    position->set_root_player(us);
+  }
+
+  if (reply.move_type == "None" || timer.stopped()) // No reply, or the opponent already moved
+    return;
+
+  {
+    std::lock_guard<std::mutex> guard(lock);
+    expected = reply;
+    predicted = true;
+  }
+
+  // The caller aged the tables for this search, whose root is two plies past our last one
+  State next = position->RESULT(reply);
+  MyMove best = tliddlmm(next, tables, cache, timer, max_depth, quiescence);
+
+  std::lock_guard<std::mutex> guard(lock);
+  result = best;
+}
+
+bool Ponderer::resolve(char file, int rank, char file2, int rank2, const std::string& promotion)
+{
+  {
+    std::lock_guard<std::mutex> guard(lock);
+    if (status != PONDERING)
+      return status == HIT;
+
+    if (predicted && expected.file == file && expected.rank == rank && expected.file2 == file2
+        && expected.rank2 == rank2 && PIECE_NAMES[expected.promotion] == promotion)
+    {
+      status = HIT;
+      return true;
+    }
+    status = MISS;
+  }
+  stop();
+  return false;
+}
+
+bool Ponderer::hit()
+{
+  std::lock_guard<std::mutex> guard(lock);
+  return status == HIT;
+}
+
+MyMove Ponderer::finish(double time_remaining, int turn, int max_turns)
+{
+  timer.adopt(time_remaining, turn, max_turns);
+  if (worker.joinable())
+    worker.join();
+
+  std::lock_guard<std::mutex> guard(lock);
+  status = IDLE;
+  return result;
+}
+
+void Ponderer::stop()
+{
+  timer.abort();
+  predictor.abort();
+  if (worker.joinable())
+    worker.join();
+
+  std::lock_guard<std::mutex> guard(lock);
+  status = IDLE;
+}
+
+}
+
+}
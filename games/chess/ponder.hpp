@@ -0,0 +1,102 @@
+////////////////////////////////////////////////////////////////////// 
+/// @file ponder.hpp 
+/// @author Shawn McCormick CS5400
+/// @brief Searching on the opponent's time
+////////////////////////////////////////////////////////////////////// 
+
+#ifndef PONDER_HPP
+#define PONDER_HPP
+
+#include "custom_board.hpp"
+#include "eval_cache.hpp"
+#include "time_manager.hpp"
+#include "search.hpp"
+
+#include <memory>
+#include <mutex>
+#include <thread>
+
+namespace cpp_client
+{
+
+namespace chess
+{
+
+////////////////////////////////////////////////////////////////////// 
+/// @class Ponderer 
+/// @brief A background search of the reply we expect from the opponent
+///
+/// After our move the worker takes the opponent's reply from our principal
+/// variation, or predicts it with a short search from their side, then searches the resulting position with no
+/// time limit. If the opponent plays the predicted move the search keeps
+/// running and is handed our real time limits; otherwise it is aborted.
+/// The worker only touches its own States and tables, the thread-safe caches,
+/// and the SearchTables, which the AI leaves alone until the worker is stopped.
+////////////////////////////////////////////////////////////////////// 
+class Ponderer {
+  private:
+    enum Status { IDLE, PONDERING, HIT, MISS };
+
+    std::thread worker; // Runs the ponder search
+    TimeManager timer; // Unlimited while pondering; adopts our limits on a hit
+    TimeManager predictor; // Limits the short search that predicts the opponent's reply
+    SearchTables prediction; // Tables for that search, so it leaves the main search's line and iterations alone
+    std::unique_ptr<State> position; // The position after our move
+    int quiescence; // Quiescence depth passed to the search
+    uint16_t suggested; // MyMove::id() of the reply from our principal variation, or 0
+
+    std::mutex lock; // Guards the members below
+    Status status; // Where the ponder search stands
+    bool predicted; // Whether expected has been chosen yet
+    MyMove expected; // The opponent's reply being pondered
+    MyMove result; // The best move found after the expected reply
+
+    // Worker body: predict the reply, then search the position after it
+    void run(SearchTables& tables, EvalCache& cache, int max_depth);
+
+  public:
+    Ponderer() : prediction(16), quiescence(3), suggested(0), status(IDLE), predicted(false) {};
+    ~Ponderer();
+
+    Ponderer(const Ponderer&) = delete;
+    Ponderer& operator=(const Ponderer&) = delete;
+
+    // Start pondering
+    // Parameters:
+    //      const State& state: The position after our move, with the opponent to move
+    //      SearchTables& tables: The tables shared with the main search, already aged for the
+    //                            search after the reply; a miss's search must not age them again
+    //      EvalCache& cache: The evaluation cache shared with the main search
+    //      int max_depth: The maximum depth to explore to
+    //      int quiescence: Number of quiescence-search depth increases allowed
+    //      uint16_t reply: MyMove::id() of the reply our principal variation expects, or 0 to predict one
+    void start(const State& state, SearchTables& tables, EvalCache& cache, int max_depth=15, int quiescence=3, uint16_t reply=0);
+
+    // Compare the opponent's actual move against the pondered reply;
+    //      on a miss the ponder search is aborted
+    // Parameters:
+    //      char file, int rank, char file2, int rank2: The move's starting and target tiles
+    //      const std::string& promotion: The promoted-to type's full name, or "" if none
+    // Returns true on a ponder hit
+    bool resolve(char file, int rank, char file2, int rank2, const std::string& promotion);
+
+    // Whether a ponder search hit and is waiting for finish()
+    bool hit();
+
+    // Give a hit search our time limits and wait for its result
+    // Parameters: as for TimeManager::start
+    // Returns the best move found in the position after the opponent's reply
+    MyMove finish(double time_remaining, int turn, int max_turns);
+
+    // Abort any ponder search and wait for the worker to exit
+    void stop();
+
+    // Nodes searched by the last ponder search
+    U64 nodes() const { return timer.nodes(); }
+};
+
+}
+
+}
+
+#endif
@@ -5,7 +5,10 @@
 ////////////////////////////////////////////////////////////////////// 
 
 #include "search.hpp"
-#include <time.h>
+
+#include <algorithm>
+#include <cmath>
+#include <limits>
 
 namespace cpp_client
 {
@@ -13,172 +16,550 @@ namespace cpp_client
 namespace chess
 {
 
-float minv(State& state, int depth, const Game& game, float alpha, float beta, int quiescence, hist &history)
+// Move ordering tiers
+const int TT_MOVE_SCORE = 1 << 30;
+const int CAPTURE_SCORE = 1 << 28;
+const int KILLER_SCORE = 1 << 26;
+
+SearchTables::SearchTables(int tt_size_log2) : tt(tt_size_log2), history(64 * 64, 0), continuation(6 * 64 * 6 * 64, 0), follow_pv(false), tablebases(nullptr)
+{
+  for (int ply = 0; ply < MAX_PLY; ply++)
+  {
+    killers[ply][0] = killers[ply][1] = 0;
+    line_piece[ply] = line_to[ply] = 0;
+    pv_length[ply] = 0;
+  }
+}
+
+void SearchTables::new_search(int plies)
+{
+  tt.new_search();
+
+  // Older cutoffs count for less
+  for (int& h : history)
+    h /= 2;
+  for (int& c : continuation)
+    c /= 2;
+
+  // The previous search's killers at ply p are at ply p - plies from the new root
+  for (int ply = 0; ply < MAX_PLY; ply++)
+  {
+    for (int k = 0; k < 2; k++)
+      killers[ply][k] = (ply + plies < MAX_PLY ? killers[ply + plies][k] : 0);
+  }
+}
+
+void SearchTables::clear()
+{
+  tt.clear();
+  std::fill(history.begin(), history.end(), 0);
+  std::fill(continuation.begin(), continuation.end(), 0);
+  for (int ply = 0; ply < MAX_PLY; ply++)
+    killers[ply][0] = killers[ply][1] = 0;
+  previous_pv.clear();
+  follow_pv = false;
+}
+
+int SearchTables::quiet_score(const State& state, const MyMove& action, int ply) const
+{
+  int score = history[action.from() * 64 + action.to()];
+  if (ply > 0)
+  {
+    int piece = state.getPiece(action.file, action.rank)->type;
+    score += continuation[((line_piece[ply - 1] * 64 + line_to[ply - 1]) * 6 + piece) * 64 + action.to()];
+  }
+  return score;
+}
+
+void SearchTables::play(const State& state, const MyMove& action, int ply)
+{
+  if (ply >= MAX_PLY)
+    return;
+  line_piece[ply] = state.getPiece(action.file, action.rank)->type;
+  line_to[ply] = action.to();
+}
+
+void SearchTables::cutoff(const State& state, const MyMove& action, int ply, int depth)
+{
+  if (action.capture != NO_PIECE || ply >= MAX_PLY) // Captures are already ordered first
+    return;
+
+  int bonus = depth * depth;
+  history[action.from() * 64 + action.to()] += bonus;
+  if (ply > 0)
+  {
+    int piece = state.getPiece(action.file, action.rank)->type;
+    continuation[((line_piece[ply - 1] * 64 + line_to[ply - 1]) * 6 + piece) * 64 + action.to()] += bonus;
+  }
+
+  uint16_t id = action.id();
+  if (killers[ply][0] != id)
+  {
+    killers[ply][1] = killers[ply][0];
+    killers[ply][0] = id;
+  }
+}
+
+void SearchTables::update_pv(const MyMove& action, int ply)
+{
+  if (ply >= MAX_PLY)
+    return;
+  pv[ply][ply] = action.id();
+  int length = (ply + 1 < MAX_PLY ? pv_length[ply + 1] : ply + 1);
+  for (int next = ply + 1; next < length; next++)
+    pv[ply][next] = pv[ply + 1][next];
+  pv_length[ply] = std::max(length, ply + 1);
+}
+
+std::vector<uint16_t> SearchTables::principal_variation() const
+{
+  return std::vector<uint16_t>(pv[0], pv[0] + pv_length[0]);
+}
+
+std::string pv_string(const std::vector<uint16_t>& pv)
+{
+  std::string line;
+  for (uint16_t id : pv)
+    line += (line.empty() ? "" : " ") + uci_from_id(id);
+  return line;
+}
+
+// The move to search first at a node: the previous iteration's principal
+// variation while the search is still following it, else the transposition move
+uint16_t first_move(SearchTables& tables, int ply, uint16_t tt_move)
+{
+  if (tables.follow_pv && ply < static_cast<int>(tables.previous_pv.size()))
+    return tables.previous_pv[ply];
+  tables.follow_pv = false;
+  return tt_move;
+}
+
+void order_moves(const State& state, std::vector<MyMove>& actions, const SearchTables& tables, uint16_t tt_move, int ply)
 {
+  std::vector<std::pair<int, MyMove>> scored;
+  scored.reserve(actions.size());
+  for (const MyMove& action : actions)
+  {
+    uint16_t id = action.id();
+    int score;
+    if (id == tt_move)
+      score = TT_MOVE_SCORE;
+    else if (action.capture != NO_PIECE) // Most valuable victim, then least valuable attacker
+      score = CAPTURE_SCORE + 16 * state.value(action.capture) - state.value(state.getPiece(action.file, action.rank)->type);
+    else if (ply < MAX_PLY && id == tables.killers[ply][0])
+      score = KILLER_SCORE + 1;
+    else if (ply < MAX_PLY && id == tables.killers[ply][1])
+      score = KILLER_SCORE;
+    else
+      score = tables.quiet_score(state, action, ply);
+    scored.push_back(std::make_pair(score, action));
+  }
+
+  std::stable_sort(scored.begin(), scored.end(),
+    [](const std::pair<int, MyMove>& a, const std::pair<int, MyMove>& b)
+    {
+        return a.first > b.first;
+    });
+
+  for (std::size_t i = 0; i < scored.size(); i++)
+    actions[i] = scored[i].second;
+}
+
+// Probe the endgame tables below the root
+//      Only positions just reached by a capture or pawn move are probed, since the
+//      tables ignore how close the 50-move rule is and those are where it is reset
+// Parameters:
+//      float& value: Set to the position's value for the root player
+// Returns true if the tables settle the position
+bool probe_tablebases(const State& state, int ply, SearchTables& tables, float& value)
+{
+  if (tables.tablebases == nullptr || !tables.root_moves.empty() || state.halfmove_clock() != 0)
+    return false;
+  WDL wdl;
+  if (!tables.tablebases->probe_wdl(state, wdl))
+    return false;
+  tables.stats.tb_hits++;
+
+  float score = DRAW;
+  if (wdl == WDL_WIN)
+    score = TB_WIN - ply;
+  else if (wdl == WDL_LOSS)
+    score = -(TB_WIN - ply);
+  // DRAW is already from the root player's perspective
+  if (score != DRAW && state.player_to_move() != state.get_root_player())
+    score = -score;
+  value = score;
+  return true;
+}
+
+// Whether a value is a tablebase win or loss, which counts down with the ply it was found at
+bool is_tb_score(float value)
+{
+  return std::abs(value) > TB_WIN - 1000 && std::abs(value) <= TB_WIN;
+}
+
+// A value as stored in the transposition table: tablebase results are counted from
+// the node rather than the root, so they stay true when reached at another ply
+float value_to_tt(float value, int ply)
+{
+  if (!is_tb_score(value))
+    return value;
+  return (value > 0 ? value + ply : value - ply);
+}
+
+// A value read from the transposition table, counted from the root again
+float value_from_tt(float value, int ply)
+{
+  if (!is_tb_score(value))
+    return value;
+  return (value > 0 ? value - ply : value + ply);
+}
+
+// Whether a stored entry settles the value of a node searched with the given window
+bool tt_cutoff(const TTEntry& entry, int depth, float alpha, float beta)
+{
+  if (entry.depth < depth)
+    return false;
+  return entry.bound == BOUND_EXACT
+    || (entry.bound == BOUND_LOWER && entry.value >= beta)
+    || (entry.bound == BOUND_UPPER && entry.value <= alpha);
+}
+
+// The bound a node's value represents, given the window it was searched with
+Bound tt_bound(float value, float alpha, float beta)
+{
+  if (value <= alpha)
+    return BOUND_UPPER;
+  if (value >= beta)
+    return BOUND_LOWER;
+  return BOUND_EXACT;
+}
+
+float minv(State& state, int depth, float alpha, float beta, int quiescence, int ply, SearchTables& tables, EvalCache& cache, TimeManager& timer)
+{
+  if (ply > tables.stats.seldepth)
+    tables.stats.seldepth = ply;
+
+  // Abandon the search once the hard deadline passes; the caller discards this iteration
+  if (timer.should_stop())
+    return 0;
+
+  tables.stats.nodes++;
+  if (depth == 0)
+    tables.stats.qnodes++;
+  if (ply < MAX_PLY)
+    tables.pv_length[ply] = ply;
+
+  // Repeated positions and the 50-move rule end the line in a draw
+  if (state.draw_by_rule())
+    return DRAW;
+
   if (depth == 0) // The depth limit has been reached, so evaluate the board state using our heuristic
   { 
     // Search deeper if the state is non-quiescent
-    if (quiescence > 0 && !state.quiescent(game))
+    if (quiescence > 0 && !state.quiescent())
     {
       quiescence--;
       depth++;
     }
     else
-      return state.evaluate(game);
+      return cache.evaluate(state);
   }
-  float best_value = std::numeric_limits<float>::infinity();
-  std::vector<MyMove> actions = state.ACTIONS(game);
-  
-  // Sort by history table
-  std::sort(actions.begin(), actions.end(),
-    [&history](const MyMove& a, const MyMove& b)
+
+  // Entering a tablebase position ends the line with its exact result
+  float tb_value;
+  if (probe_tablebases(state, ply, tables, tb_value))
+    return tb_value;
+
+  // A previous search of this position may settle it, or at least suggest a move
+  U64 key = state.perspective_hash();
+  TTEntry entry;
+  uint16_t tt_move = 0;
+  tables.stats.tt_probes++;
+  if (tables.tt.probe(key, entry))
+  {
+    tables.stats.tt_hits++;
+    entry.value = value_from_tt(entry.value, ply);
+    if (tt_cutoff(entry, depth, alpha, beta))
     {
-        return ((history.find(a.hash()) == history.end()) ? 0 : history[a.hash()]) > ((history.find(b.hash()) == history.end()) ? 0 : history[b.hash()]);
-    });
+      // The stored search reached at least its depth below here
+      tables.stats.seldepth = std::max(tables.stats.seldepth, ply + entry.depth);
+      return entry.value;
+    }
+    tt_move = entry.move;
+  }
+
+  const float alpha_orig = alpha;
+  const float beta_orig = beta;
+  float best_value = std::numeric_limits<float>::infinity();
+  MyMove best_action;
+  std::vector<MyMove> actions = state.ACTIONS();
+  uint16_t first = first_move(tables, ply, tt_move);
+  order_moves(state, actions, tables, first, ply);
   
-  for (MyMove action : actions) // Find the min of all neighbors
+  for (const MyMove& action : actions) // Find the min of all neighbors
   {
+    tables.play(state, action, ply);
+    tables.follow_pv = (tables.follow_pv && action.id() == first);
     auto preserved = state.APPLY(action);
-    float new_val = maxv(state, depth - 1, game, alpha, beta, quiescence, history); 
-    state.UNDO(action, preserved);
-    if (new_val > alpha && new_val < beta)
-    {
-      beta = new_val;
-    }
-    else if (new_val <= alpha) // fail low, so prune
-    {
-      if (history.find(action.hash()) == history.end())
-        history[action.hash()] = 0;
-      history[action.hash()] += 1;
+    float new_val = maxv(state, depth - 1, alpha, beta, quiescence, ply + 1, tables, cache, timer); 
+    state.UNDO(preserved);
+    tables.follow_pv = false;
+    if (timer.stopped())
+      return 0;
 
-      return new_val;
-    }
-    if (best_value < new_val)
+    if (new_val < best_value)
     {
       best_value = new_val;
+      best_action = action;
+    }
+    if (new_val < beta) // A new best line for the minimizer
+      tables.update_pv(action, ply);
+    if (best_value < beta)
+      beta = best_value;
+    if (beta <= alpha) // fail low, so prune
+    {
+      tables.stats.beta_cutoffs++;
+      if (&action == &actions.front())
+        tables.stats.first_move_cutoffs++;
+      tables.cutoff(state, action, ply, depth);
+      break;
     }
-    // else fail high, so ignore
   }
 
-  if (best_value == std::numeric_limits<float>::infinity())
+  if (actions.empty())
   {
     // There are no moves remaining, so a checkmate or stalemate has occurred
-    return state.evaluate(game);
+    return cache.evaluate(state);
   }
+
+  // A draw may come from a repetition or the 50-move rule, which depend on the path
+  // here rather than the position, so it is not stored for other paths to find
+  if (best_value != DRAW)
+    tables.tt.store(key, depth, value_to_tt(best_value, ply), tt_bound(best_value, alpha_orig, beta_orig), best_action.id());
   return best_value;
 }
 
-float maxv(State& state, int depth, const Game& game, float alpha, float beta, int quiescence, hist &history)
+float maxv(State& state, int depth, float alpha, float beta, int quiescence, int ply, SearchTables& tables, EvalCache& cache, TimeManager& timer)
 {
+  if (ply > tables.stats.seldepth)
+    tables.stats.seldepth = ply;
+
+  // Abandon the search once the hard deadline passes; the caller discards this iteration
+  if (timer.should_stop())
+    return 0;
+
+  tables.stats.nodes++;
+  if (depth == 0)
+    tables.stats.qnodes++;
+  if (ply < MAX_PLY)
+    tables.pv_length[ply] = ply;
+
+  // Repeated positions and the 50-move rule end the line in a draw
+  if (state.draw_by_rule())
+    return DRAW;
+
   if (depth == 0) // The depth limit has been reached, so evaluate the board state using our heuristic
   { 
     // Search deeper if the state is non-quiescent
-    if (quiescence > 0 && !state.quiescent(game))
+    if (quiescence > 0 && !state.quiescent())
     {
       quiescence--;
       depth++;
     }
     else
-      return state.evaluate(game);
+      return cache.evaluate(state);
   }
 
-  float best_value = -std::numeric_limits<float>::infinity();
-  std::vector<MyMove> actions = state.ACTIONS(game);
+  // Entering a tablebase position ends the line with its exact result
+  float tb_value;
+  if (probe_tablebases(state, ply, tables, tb_value))
+    return tb_value;
 
-  // Sort by history table
-  std::sort(actions.begin(), actions.end(),
-    [&history](const MyMove& a, const MyMove& b)
+  // A previous search of this position may settle it, or at least suggest a move
+  U64 key = state.perspective_hash();
+  TTEntry entry;
+  uint16_t tt_move = 0;
+  tables.stats.tt_probes++;
+  if (tables.tt.probe(key, entry))
+  {
+    tables.stats.tt_hits++;
+    entry.value = value_from_tt(entry.value, ply);
+    if (tt_cutoff(entry, depth, alpha, beta))
     {
-        return ((history.find(a.hash()) == history.end()) ? 0 : history[a.hash()]) > ((history.find(b.hash()) == history.end()) ? 0 : history[b.hash()]);
-    });
+      // The stored search reached at least its depth below here
+      tables.stats.seldepth = std::max(tables.stats.seldepth, ply + entry.depth);
+      return entry.value;
+    }
+    tt_move = entry.move;
+  }
 
-  for (MyMove action : actions) // Find the max of all neighbors
+  const float alpha_orig = alpha;
+  const float beta_orig = beta;
+  float best_value = -std::numeric_limits<float>::infinity();
+  MyMove best_action;
+  std::vector<MyMove> actions = state.ACTIONS();
+  uint16_t first = first_move(tables, ply, tt_move);
+  order_moves(state, actions, tables, first, ply);
+
+  for (const MyMove& action : actions) // Find the max of all neighbors
   {
+    tables.play(state, action, ply);
+    tables.follow_pv = (tables.follow_pv && action.id() == first);
     auto preserved = state.APPLY(action);
-    float new_val = minv(state, depth - 1, game, alpha, beta, quiescence, history); 
-    state.UNDO(action, preserved);
+    float new_val = minv(state, depth - 1, alpha, beta, quiescence, ply + 1, tables, cache, timer); 
+    state.UNDO(preserved);
+    tables.follow_pv = false;
+    if (timer.stopped())
+      return 0;
 
-    if (new_val > alpha && new_val < beta)
-    {
-      alpha = new_val;
-    }
-    else if (new_val >= beta) // fail high, so prune
+    if (new_val > best_value)
     {
-      // Update the history table
-      if (history.find(action.hash()) == history.end())
-        history[action.hash()] = 0;
-      history[action.hash()] += 1;
-
-      return new_val;
+      best_value = new_val;
+      best_action = action;
     }
-    if (best_value > new_val)
+    if (new_val > alpha) // A new best line for the maximizer
+      tables.update_pv(action, ply);
+    if (best_value > alpha)
+      alpha = best_value;
+    if (alpha >= beta) // fail high, so prune
     {
-      best_value = new_val;
+      tables.stats.beta_cutoffs++;
+      if (&action == &actions.front())
+        tables.stats.first_move_cutoffs++;
+      tables.cutoff(state, action, ply, depth);
+      break;
     }
-    // else fail low, so ignore
   }
 
-  if (best_value == -std::numeric_limits<float>::infinity())
+  if (actions.empty())
   {
     // There are no moves remaining, so a checkmate or stalemate has occurred
-    return state.evaluate(game);
+    return cache.evaluate(state);
   }
+
+  // A draw may come from a repetition or the 50-move rule, which depend on the path
+  // here rather than the position, so it is not stored for other paths to find
+  if (best_value != DRAW)
+    tables.tt.store(key, depth, value_to_tt(best_value, ply), tt_bound(best_value, alpha_orig, beta_orig), best_action.id());
   return best_value;
 }
 
-MyMove dlmm(const Game& game, State& current_state, int max_depth, int &best_value, int quiescence, hist& history)
+MyMove dlmm(State& current_state, int max_depth, int &best_value, int quiescence, SearchTables& tables, EvalCache& cache, TimeManager& timer)
 {
   float alpha = -std::numeric_limits<float>::infinity();
   float beta = std::numeric_limits<float>::infinity();
   MyMove best_action;
+  tables.stats.nodes++;
+
+  U64 key = current_state.perspective_hash();
+  TTEntry entry;
+  uint16_t tt_move = (tables.tt.probe(key, entry) ? entry.move : 0);
 
-  auto actions = current_state.ACTIONS(game);
+  tables.pv_length[0] = 0;
+  tables.follow_pv = !tables.previous_pv.empty();
+  uint16_t first = first_move(tables, 0, tt_move);
 
-  // Sort by history table
-  std::sort(actions.begin(), actions.end(),
-    [&history](const MyMove& a, const MyMove& b)
+  auto actions = current_state.ACTIONS();
+  if (!tables.root_moves.empty())
+  {
+    actions.erase(std::remove_if(actions.begin(), actions.end(), [&tables](const MyMove& action)
     {
-        return ((history.find(a.hash()) == history.end()) ? 0 : history[a.hash()]) > ((history.find(b.hash()) == history.end()) ? 0 : history[b.hash()]);
-    });
+      return std::find(tables.root_moves.begin(), tables.root_moves.end(), action.id()) == tables.root_moves.end();
+    }), actions.end());
+  }
+  order_moves(current_state, actions, tables, first, 0);
+
+  if (!actions.empty())
+    best_action = actions.front();
 
   for (auto action: actions)
   {
+    tables.play(current_state, action, 0);
+    tables.follow_pv = (tables.follow_pv && action.id() == first);
     auto preserved = current_state.APPLY(action);
-    float new_val = minv(current_state, max_depth - 1, game, alpha, beta, quiescence, history); 
-    current_state.UNDO(action, preserved);
+    float new_val = minv(current_state, max_depth - 1, alpha, beta, quiescence, 1, tables, cache, timer); 
+    current_state.UNDO(preserved);
+    tables.follow_pv = false;
+    if (timer.stopped()) // Out of time, so this value is incomplete
+      break;
     if (new_val > alpha)
     {
       alpha = new_val;
       best_action = action;
+      tables.update_pv(action, 0);
     }
     // else fail low, so ignore
   }
 
   best_value = alpha;
 
-  // Update the history table
-  if (history.find(best_action.hash()) == history.end())
-    history[best_action.hash()] = 0;
-  history[best_action.hash()] += 1;
+  if (!timer.stopped() && !actions.empty() && alpha != DRAW)
+    tables.tt.store(key, max_depth, alpha, BOUND_EXACT, best_action.id());
 
   return best_action;
 }
 
-MyMove tliddlmm(const Game& game, State& current_state, int max_depth, int max_time, int quiescence)
+MyMove tliddlmm(State& current_state, SearchTables& tables, EvalCache& cache, TimeManager& timer, int max_depth, int quiescence)
 {
   MyMove best_action;
-  int best_value;
-  time_t start = time(NULL);
-  hist history;
+  int best_value = 0;
+  tables.iterations.clear();
+  tables.previous_pv.clear();
+
+  // With the root in the tablebases, search only the moves that keep its result;
+  // probing below would score them all alike and leave the search no way to make progress
+  tables.root_moves.clear();
+  if (tables.tablebases != nullptr && tables.tablebases->can_probe(current_state))
+  {
+    std::vector<MyMove> root_moves = current_state.ACTIONS();
+    if (tables.tablebases->probe_root(current_state, root_moves))
+      for (const MyMove& action : root_moves)
+        tables.root_moves.push_back(action.id());
+  }
   for (int i = 1; i <= max_depth; i++)
   {
-    best_action = dlmm(game, current_state, i, best_value, quiescence, history);
+    int value;
+    double started = timer.elapsed();
+    tables.stats.clear();
+    MyMove action = dlmm(current_state, i, value, quiescence, tables, cache, timer);
+
+    IterationStats iteration;
+    iteration.depth = i;
+    iteration.value = value;
+    iteration.move = action.uci();
+    iteration.seconds = timer.elapsed() - started;
+    iteration.complete = !timer.stopped();
+    iteration.stats = tables.stats;
+    if (iteration.complete)
+    {
+      // The next iteration searches this line first
+      tables.previous_pv = tables.principal_variation();
+      iteration.pv = pv_string(tables.previous_pv);
+    }
+    tables.iterations.push_back(iteration);
+
+    if (timer.stopped()) // Hard limit reached; fall back on the previous iteration
+    {
+      if (i == 1)
+        best_action = action;
+      break;
+    }
+
+    // Spend longer when the root is unsettled
+    if (i > 1 && action.hash() != best_action.hash()) // Best move changed
+      timer.extend(1.4);
+    if (i > 1 && value <= best_value - 1) // Score dropped by a pawn or more
+      timer.extend(1.2);
+
+    best_action = action;
+    best_value = value;
 
     if (best_value >= 10000 || best_value <= -10000) // Checkmate imminent, no need to keep searching
     {
       break;
     }
-    else if (difftime(time(NULL), start) > max_time) // Time limit exceeded; return current best action
+    else if (!timer.can_start_iteration()) // Another iteration would likely not finish in time
     {
       break;
     }
@@ -188,4 +569,4 @@ MyMove tliddlmm(const Game& game, State& current_state, int max_depth, int max_t
 
 } //chess
 
-} //cpp_client
\ No newline at end of file
+} //cpp_client
@@ -1,5 +1,5 @@
 ////////////////////////////////////////////////////////////////////// 
-/// @file custom_board.hpp 
+/// @file search.hpp 
 /// @author Shawn McCormick CS5400
 /// @brief MiniMax Search functions for Chess
 ////////////////////////////////////////////////////////////////////// 
@@ -7,15 +7,12 @@
 #ifndef SEARCH_HPP
 #define SEARCH_HPP
 
-#include "impl/chess.hpp"
-#include "game.hpp"
-#include "game_object.hpp"
-#include "move.hpp"
-#include "piece.hpp"
-#include "player.hpp"
-
 #include "custom_board.hpp"
-#include <unordered_map>
+#include "eval_cache.hpp"
+#include "search_stats.hpp"
+#include "tablebase.hpp"
+#include "time_manager.hpp"
+#include "transposition.hpp"
 
 namespace cpp_client
 {
@@ -23,38 +20,120 @@ namespace cpp_client
 namespace chess
 {
 
-using hist = std::unordered_map<std::string, int>;
+// Deepest ply the search tables track
+const int MAX_PLY = 64;
+
+////////////////////////////////////////////////////////////////////// 
+/// @class SearchTables 
+/// @brief Transposition and move-ordering tables kept across searches
+///
+/// The AI owns one of these for the whole game, so each turn's search
+/// starts from what the previous turns (and pondering) learned.
+/// new_search() ages everything rather than clearing it.
+////////////////////////////////////////////////////////////////////// 
+struct SearchTables {
+    TranspositionTable tt; // Results of positions already searched
+    std::vector<int> history; // [from][to]: how often a quiet move caused a cutoff
+    std::vector<int> continuation; // [piece][to][piece][to]: the same, following the previous move
+    uint16_t killers[MAX_PLY][2]; // Quiet moves that caused a cutoff at each ply
+
+    // The move made at each ply of the current line, for continuation history
+    int line_piece[MAX_PLY]; // PieceType of the moving piece
+    int line_to[MAX_PLY]; // Target tile of the move
+
+    // Triangular principal variation table: pv[ply][ply..pv_length[ply]) is the
+    // best line found from ply, as MyMove::id()s
+    uint16_t pv[MAX_PLY][MAX_PLY];
+    int pv_length[MAX_PLY];
+
+    // The previous iteration's principal variation, searched first by the next
+    std::vector<uint16_t> previous_pv;
+    bool follow_pv; // Whether the node being searched is still on previous_pv
+
+    // Endgame tables probed below the root, or nullptr; not owned
+    const Tablebases* tablebases;
+
+    // When the root is in the tablebases, the root moves that keep its result, as MyMove::id()s;
+    //      the search is limited to these and does not probe below them. Set by tliddlmm
+    std::vector<uint16_t> root_moves;
+
+    // Counters for the iteration in progress; only the thread searching with these tables touches them
+    SearchStats stats;
+
+    // The iterations of the most recent tliddlmm call, shallowest first
+    std::vector<IterationStats> iterations;
+
+    // Parameters:
+    //      int tt_size_log2: The transposition table has 2^tt_size_log2 slots
+    explicit SearchTables(int tt_size_log2 = 20);
+
+    SearchTables(const SearchTables&) = delete;
+    SearchTables& operator=(const SearchTables&) = delete;
+
+    // Age the tables before a new search
+    // Parameters:
+    //      int plies: How many plies the new root is past the previous one; killers shift by this much
+    void new_search(int plies = 2);
+
+    // Forget everything learned, as before a new game
+    void clear();
+
+    // Ordering score of a quiet move from history and continuation history
+    int quiet_score(const State& state, const MyMove& action, int ply) const;
+
+    // Record the move made at a ply of the current line
+    void play(const State& state, const MyMove& action, int ply);
+
+    // Reward a quiet move that caused a cutoff
+    void cutoff(const State& state, const MyMove& action, int ply, int depth);
+
+    // Record that action is the best move so far at ply, followed by the line found below it
+    void update_pv(const MyMove& action, int ply);
+
+    // The principal variation from the root of the last search
+    std::vector<uint16_t> principal_variation() const;
+};
+
+// The moves of a principal variation in coordinate notation, separated by spaces
+std::string pv_string(const std::vector<uint16_t>& pv);
+
+// Order moves best-first: the transposition move, captures by victim then attacker,
+// killers, then quiet moves by history and continuation history
+void order_moves(const State& state, std::vector<MyMove>& actions, const SearchTables& tables, uint16_t tt_move, int ply);
 
 // Find the lowest possible value from all actions
-float minv(State& state, int depth, const Game& game, float alpha, float beta, int quiescence, hist& history);
+float minv(State& state, int depth, float alpha, float beta, int quiescence, int ply, SearchTables& tables, EvalCache& cache, TimeManager& timer);
 
 // Find the highest possible value from all actions
-float maxv(State& state, int depth, const Game& game, float alpha, float beta, int quiescence, hist& history);
+float maxv(State& state, int depth, float alpha, float beta, int quiescence, int ply, SearchTables& tables, EvalCache& cache, TimeManager& timer);
 
-// Perform Depth-limited Minimax Search w/ quiescence search + history table
+// Perform Depth-limited Minimax Search w/ quiescence search + transposition and history tables
 // Parameters:
-//      Game& game: The game object
 //      State& current_state: The starting state
 //      int max_depth: The maximum depth to explore to
-//      float alpha: The best value available for the max player
-//      float beta: The best value available for the min player
+//      int& best_value: Set to the value of the best action
 //      int quiescence: Number of quiescence-search depth increases allowed
-//      std::unordered_map<std::string, int> history: The move history table
+//      SearchTables& tables: The transposition and move-ordering tables
+//      EvalCache& cache: The static evaluation cache
+//      TimeManager& timer: Polled for the hard deadline; the search is abandoned when it passes
 // Returns the best action found to take from the given state
-MyMove dlmm(const Game& game, State& current_state, int max_depth, int &best_value, int quiescence, hist& history);
+MyMove dlmm(State& current_state, int max_depth, int &best_value, int quiescence, SearchTables& tables, EvalCache& cache, TimeManager& timer);
 
 // Perform Time-limited Iterative deepening depth-limited alpha-beta pruning Minimax Search
 // Parameters:
-//      Game& game: The game object
 //      State& current_state: The starting state
+//      SearchTables& tables: The transposition and move-ordering tables, aged by the caller
+//      EvalCache& cache: The static evaluation cache
+//      TimeManager& timer: The started time manager; its soft limit ends the deepening,
+//                          its hard limit aborts the current iteration
 //      int max_depth: The maximum depth to explore to
-//      int max_time: The maximim time to spend, in seconds
 //      int quiescence: Number of quiescence-search depth increases allowed
-// Returns the best action found to take from the given state 
-MyMove tliddlmm(const Game& game, State& current_state, int max_depth=15, int max_time=1, int quiescence=3);
+// Returns the best action found by the last completed iteration
+//      Each iteration's counters are left in tables.iterations
+MyMove tliddlmm(State& current_state, SearchTables& tables, EvalCache& cache, TimeManager& timer, int max_depth=15, int quiescence=3);
 
 }
 
 }
 
-#endif
\ No newline at end of file
+#endif
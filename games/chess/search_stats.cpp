@@ -0,0 +1,160 @@
+////////////////////////////////////////////////////////////////////// 
+/// @file search_stats.cpp 
+/// @author Shawn McCormick CS5400
+/// @brief Implementation of search statistics and their reports
+////////////////////////////////////////////////////////////////////// 
+
+#include "search_stats.hpp"
+
+#include <algorithm>
+#include <iomanip>
+#include <sstream>
+
+namespace cpp_client
+{
+
+namespace chess
+{
+
+void SearchStats::clear()
+{
+  nodes = qnodes = 0;
+  beta_cutoffs = first_move_cutoffs = 0;
+  tt_probes = tt_hits = 0;
+  tb_hits = 0;
+  seldepth = 0;
+}
+
+SearchStats& SearchStats::operator+=(const SearchStats& other)
+{
+  nodes += other.nodes;
+  qnodes += other.qnodes;
+  beta_cutoffs += other.beta_cutoffs;
+  first_move_cutoffs += other.first_move_cutoffs;
+  tt_probes += other.tt_probes;
+  tt_hits += other.tt_hits;
+  tb_hits += other.tb_hits;
+  seldepth = std::max(seldepth, other.seldepth);
+  return *this;
+}
+
+double SearchStats::first_move_cutoff_rate() const
+{
+  return (beta_cutoffs == 0 ? 0 : static_cast<double>(first_move_cutoffs) / beta_cutoffs);
+}
+
+double SearchStats::tt_hit_rate() const
+{
+  return (tt_probes == 0 ? 0 : static_cast<double>(tt_hits) / tt_probes);
+}
+
+double effective_branching_factor(const std::vector<IterationStats>& iterations)
+{
+  const IterationStats* last = nullptr;
+  const IterationStats* before = nullptr;
+  for (const IterationStats& iteration : iterations)
+  {
+    if (!iteration.complete)
+      continue;
+    before = last;
+    last = &iteration;
+  }
+  if (before == nullptr || before->stats.nodes == 0)
+    return 0;
+  return static_cast<double>(last->stats.nodes) / before->stats.nodes;
+}
+
+SearchStats total_stats(const std::vector<IterationStats>& iterations)
+{
+  SearchStats total;
+  for (const IterationStats& iteration : iterations)
+    total += iteration.stats;
+  return total;
+}
+
+// The deepest complete iteration, or the first one if none completed
+const IterationStats* deepest(const std::vector<IterationStats>& iterations)
+{
+  const IterationStats* best = (iterations.empty() ? nullptr : &iterations.front());
+  for (const IterationStats& iteration : iterations)
+    if (iteration.complete)
+      best = &iteration;
+  return best;
+}
+
+// Escape a string for a JSON value
+std::string json_escape(const std::string& text)
+{
+  std::string escaped;
+  for (char c : text)
+  {
+    if (c == '"' || c == '\\')
+      escaped += '\\';
+    if (static_cast<unsigned char>(c) >= 0x20)
+      escaped += c;
+  }
+  return escaped;
+}
+
+std::string stats_line(int turn, const std::vector<IterationStats>& iterations, const std::string& note)
+{
+  SearchStats total = total_stats(iterations);
+  double seconds = 0;
+  for (const IterationStats& iteration : iterations)
+    seconds += iteration.seconds;
+  const IterationStats* best = deepest(iterations);
+
+  std::ostringstream line;
+  line << std::fixed << std::setprecision(2)
+       << "turn " << turn
+       << " move " << (best ? best->move : "none")
+       << " depth " << (best ? best->depth : 0) << "/" << total.seldepth
+       << " value " << (best ? best->value : 0)
+       << " nodes " << total.nodes
+       << " qnodes " << total.qnodes
+       << " time " << seconds
+       << " nps " << static_cast<U64>(seconds > 0 ? total.nodes / seconds : 0)
+       << " ebf " << effective_branching_factor(iterations)
+       << " fmc " << std::setprecision(0) << total.first_move_cutoff_rate() * 100 << "%"
+       << " cutoffs " << total.beta_cutoffs
+       << " tt " << total.tt_hit_rate() * 100 << "%";
+  if (total.tb_hits > 0)
+    line << " tb " << total.tb_hits;
+  if (!note.empty())
+    line << " " << note;
+  if (best && !best->pv.empty())
+    line << " pv " << best->pv;
+  return line.str();
+}
+
+std::string stats_json(int turn, const std::vector<IterationStats>& iterations, const std::string& note)
+{
+  std::ostringstream json;
+  json << "{\"turn\":" << turn << ",\"note\":\"" << json_escape(note) << "\",\"iterations\":[";
+  for (std::size_t i = 0; i < iterations.size(); i++)
+  {
+    const IterationStats& iteration = iterations[i];
+    const SearchStats& stats = iteration.stats;
+    json << (i > 0 ? "," : "")
+         << "{\"depth\":" << iteration.depth
+         << ",\"complete\":" << (iteration.complete ? "true" : "false")
+         << ",\"move\":\"" << json_escape(iteration.move) << "\""
+         << ",\"pv\":\"" << json_escape(iteration.pv) << "\""
+         << ",\"value\":" << iteration.value
+         << ",\"seconds\":" << iteration.seconds
+         << ",\"nodes\":" << stats.nodes
+         << ",\"qnodes\":" << stats.qnodes
+         << ",\"beta_cutoffs\":" << stats.beta_cutoffs
+         << ",\"first_move_cutoffs\":" << stats.first_move_cutoffs
+         << ",\"tt_probes\":" << stats.tt_probes
+         << ",\"tt_hits\":" << stats.tt_hits
+         << ",\"tb_hits\":" << stats.tb_hits
+         << ",\"seldepth\":" << stats.seldepth << "}";
+  }
+  json << "],\"ebf\":" << effective_branching_factor(iterations) << "}";
+  return json.str();
+}
+
+}
+
+}
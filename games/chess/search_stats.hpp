@@ -0,0 +1,87 @@
+////////////////////////////////////////////////////////////////////// 
+/// @file search_stats.hpp 
+/// @author Shawn McCormick CS5400
+/// @brief Counters describing how a search spent its nodes
+////////////////////////////////////////////////////////////////////// 
+
+#ifndef SEARCH_STATS_HPP
+#define SEARCH_STATS_HPP
+
+#include <string>
+#include <vector>
+
+typedef unsigned long long U64;
+
+namespace cpp_client
+{
+
+namespace chess
+{
+
+////////////////////////////////////////////////////////////////////// 
+/// @class SearchStats 
+/// @brief Plain counters bumped by one search thread
+///
+/// The counters are not atomic; each thread keeps its own and they are
+/// added together with += once the threads finish.
+////////////////////////////////////////////////////////////////////// 
+struct SearchStats {
+    U64 nodes; // Nodes entered, including quiescence nodes
+    U64 qnodes; // Nodes entered at or past the depth limit
+    U64 beta_cutoffs; // Nodes that pruned their remaining moves
+    U64 first_move_cutoffs; // Cutoffs caused by the first move searched
+    U64 tt_probes; // Transposition table lookups
+    U64 tt_hits; // Lookups that found the position
+    U64 tb_hits; // Nodes settled by an endgame tablebase
+    int seldepth; // Deepest ply reached; a transposition cutoff counts as reaching the depth it stored
+
+    SearchStats() { clear(); }
+
+    void clear();
+
+    SearchStats& operator+=(const SearchStats& other);
+
+    // Fraction of cutoffs caused by the first move; a measure of move ordering
+    double first_move_cutoff_rate() const;
+
+    // Fraction of transposition table lookups that found the position
+    double tt_hit_rate() const;
+};
+
+////////////////////////////////////////////////////////////////////// 
+/// @class IterationStats 
+/// @brief What one iteration of iterative deepening found and cost
+////////////////////////////////////////////////////////////////////// 
+struct IterationStats {
+    int depth; // The depth limit of the iteration
+    int value; // Value of the best move
+    std::string move; // The best move, in coordinate notation
+    std::string pv; // The principal variation, in coordinate notation separated by spaces
+    double seconds; // Time spent on this iteration alone
+    bool complete; // False if the iteration was cut off by the hard limit
+    SearchStats stats; // Counters for this iteration alone
+};
+
+// Effective branching factor of the last complete iteration:
+//      its nodes divided by those of the complete iteration before it
+// Returns 0 when fewer than two iterations completed
+double effective_branching_factor(const std::vector<IterationStats>& iterations);
+
+// Counters summed over every iteration
+SearchStats total_stats(const std::vector<IterationStats>& iterations);
+
+// One-line summary of a turn's search, for the console
+// Parameters:
+//      int turn: The game turn searched
+//      const std::vector<IterationStats>& iterations: The search's iterations, shallowest first
+//      const std::string& note: Appended verbatim, e.g. cache or ponder results; may be empty
+std::string stats_line(int turn, const std::vector<IterationStats>& iterations, const std::string& note);
+
+// The same as a single JSON object, with every iteration listed, for offline analysis
+std::string stats_json(int turn, const std::vector<IterationStats>& iterations, const std::string& note);
+
+}
+
+}
+
+#endif
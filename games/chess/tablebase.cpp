@@ -0,0 +1,63 @@
+//////////////////////////////////////////////////////////////////////
+/// @file tablebase.cpp
+/// @author Shawn McCormick CS5400
+/// @brief Endgame tablebase probing for the search
+//////////////////////////////////////////////////////////////////////
+
+#include "tablebase.hpp"
+#include "bitbase.hpp"
+
+namespace cpp_client
+{
+
+namespace chess
+{
+
+bool Tablebases::can_probe(const State& state) const
+{
+  return state.piece_count() == 3 && state.castling_rights() == 0 && BITBASES.ready();
+}
+
+bool Tablebases::probe_wdl(const State& state, WDL& result) const
+{
+  return can_probe(state) && BITBASES.probe(state, result);
+}
+
+bool Tablebases::probe_root(State& state, std::vector<MyMove>& moves) const
+{
+  if (!can_probe(state))
+    return false;
+
+  // Each move's result, for the player moving; the opponent's result after it, negated
+  std::vector<int> results;
+  int best = WDL_LOSS;
+  for (const MyMove& move : moves)
+  {
+    auto preserved = state.APPLY(move);
+    WDL reply;
+    bool known = true;
+    if (!state.actions_exist())
+      reply = (state.in_check() ? WDL_LOSS : WDL_DRAW);
+    else if (state.stalemate()) // Captures and minor promotions that leave too little to mate
+      reply = WDL_DRAW;
+    else
+      known = probe_wdl(state, reply);
+    state.UNDO(preserved);
+    if (!known)
+      return false;
+    results.push_back(-reply);
+    best = std::max(best, -static_cast<int>(reply));
+  }
+
+  // Without DTZ to rank the moves that keep a win, the search chooses among them
+  std::vector<MyMove> kept;
+  for (std::size_t k = 0; k < moves.size(); k++)
+    if (results[k] == best)
+      kept.push_back(moves[k]);
+  moves.swap(kept);
+  return true;
+}
+
+}
+
+}
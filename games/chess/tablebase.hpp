@@ -0,0 +1,58 @@
+//////////////////////////////////////////////////////////////////////
+/// @file tablebase.hpp
+/// @author Shawn McCormick CS5400
+/// @brief Endgame tablebase probing for the search
+//////////////////////////////////////////////////////////////////////
+
+#ifndef TABLEBASE_HPP
+#define TABLEBASE_HPP
+
+#include "custom_board.hpp"
+
+#include <vector>
+
+namespace cpp_client
+{
+
+namespace chess
+{
+
+// Result of a position for the player to move
+//      The values negate between the two players, as a result seen from the other side
+enum WDL { WDL_LOSS = -2, WDL_DRAW = 0, WDL_WIN = 2 };
+
+// Value of a won tablebase position at the root, less one per ply to it;
+//      below checkmate so a mate the search sees is still preferred
+const int TB_WIN = 500000;
+
+//////////////////////////////////////////////////////////////////////
+/// @class Tablebases
+/// @brief The endgame results the search can look up
+///
+/// Probes are answered by the built-in BITBASES, which cover every
+/// three-piece ending. Positions with more pieces or with castling
+/// rights are never probed, so the check the search makes at each node
+/// is a piece count and nothing more.
+//////////////////////////////////////////////////////////////////////
+class Tablebases {
+  public:
+    // Whether a position is small enough and free of castling rights to probe
+    bool can_probe(const State& state) const;
+
+    // Win, draw or loss for the player to move
+    // Returns false if the position is not in the tables
+    bool probe_wdl(const State& state, WDL& result) const;
+
+    // Narrow the root moves to those that keep the position's tablebase result
+    // Parameters:
+    //      State& state: The root position; restored before returning
+    //      std::vector<MyMove>& moves: Every legal move; on success only the moves that keep the result
+    // Returns false, leaving moves alone, if the root or any move's result is unknown
+    bool probe_root(State& state, std::vector<MyMove>& moves) const;
+};
+
+}
+
+}
+
+#endif
@@ -0,0 +1,140 @@
+////////////////////////////////////////////////////////////////////// 
+/// @file time_manager.cpp 
+/// @author Shawn McCormick CS5400
+/// @brief Implementation of search time allocation
+////////////////////////////////////////////////////////////////////// 
+
+#include "time_manager.hpp"
+
+#include <algorithm>
+
+namespace cpp_client
+{
+
+namespace chess
+{
+
+// Time held back for the network round trip of every move, in nanoseconds
+const double MOVE_OVERHEAD = 50e6;
+
+// How many of our moves the remaining clock is divided between, at most
+const int MOVE_HORIZON = 40;
+
+// How far extensions may stretch the soft limit
+const double MAX_EXTENSION = 3.0;
+
+// How far the hard limit may reach past the soft limit, and into the usable clock
+const double HARD_PER_SOFT = 2.0;
+const double HARD_PER_CLOCK = 0.1;
+
+// How long the next iteration is expected to take, as a multiple of the search so far
+const double NEXT_ITERATION_COST = 1.0;
+
+TimeManager::TimeManager()
+{
+  start_fixed(1, 1);
+}
+
+void TimeManager::allocate(double time_remaining, int turn, int max_turns, double& soft, double& hard)
+{
+  double usable = std::max(time_remaining - MOVE_OVERHEAD, 1e6);
+
+  // Spread the clock over our remaining moves, expecting the game to end before max_turns
+  int moves_left = std::max((max_turns - turn + 1) / 2, 1);
+  int moves_to_go = std::min(moves_left, std::max(MOVE_HORIZON - turn / 4, MOVE_HORIZON / 2));
+
+  soft = usable / moves_to_go;
+  hard = std::min(soft * HARD_PER_SOFT, usable * HARD_PER_CLOCK);
+  soft = std::min(soft, hard);
+  soft /= 1e9;
+  hard /= 1e9;
+}
+
+void TimeManager::start(double time_remaining, int turn, int max_turns)
+{
+  double soft, hard;
+  allocate(time_remaining, turn, max_turns, soft, hard);
+  start_fixed(soft, hard);
+}
+
+void TimeManager::start_fixed(double soft, double hard)
+{
+  set_limits(soft, hard);
+  {
+    std::lock_guard<std::mutex> guard(limits_lock);
+    start_time = limits_from;
+  }
+  node_count = 0;
+  stop = false;
+}
+
+void TimeManager::start_infinite()
+{
+  // A year is as good as forever, and still fits in a duration
+  start_fixed(3e7, 3e7);
+}
+
+void TimeManager::adopt(double time_remaining, int turn, int max_turns)
+{
+  double soft, hard;
+  allocate(time_remaining, turn, max_turns, soft, hard);
+  set_limits(soft, hard);
+}
+
+void TimeManager::set_limits(double soft, double hard)
+{
+  using std::chrono::duration_cast;
+  std::lock_guard<std::mutex> guard(limits_lock);
+  limits_from = clock::now();
+  soft_limit = duration_cast<clock::duration>(std::chrono::duration<double>(soft));
+  hard_limit = duration_cast<clock::duration>(std::chrono::duration<double>(hard));
+  max_soft = std::min(duration_cast<clock::duration>(soft_limit * MAX_EXTENSION), hard_limit);
+}
+
+bool TimeManager::should_stop()
+{
+  if (++node_count % CHECK_INTERVAL == 0 && !stop)
+  {
+    std::lock_guard<std::mutex> guard(limits_lock);
+    if (clock::now() - limits_from >= hard_limit)
+      stop = true;
+  }
+  return stop;
+}
+
+bool TimeManager::can_start_iteration() const
+{
+  std::lock_guard<std::mutex> guard(limits_lock);
+  clock::time_point now = clock::now();
+  // The same as elapsed() < soft / 2 for a search timed from its start
+  auto next_iteration = std::chrono::duration_cast<clock::duration>((now - start_time) * NEXT_ITERATION_COST);
+  return (now - limits_from) + next_iteration < soft_limit;
+}
+
+void TimeManager::extend(double factor)
+{
+  std::lock_guard<std::mutex> guard(limits_lock);
+  soft_limit = std::min(std::chrono::duration_cast<clock::duration>(soft_limit * factor), max_soft);
+}
+
+double TimeManager::elapsed() const
+{
+  std::lock_guard<std::mutex> guard(limits_lock);
+  return std::chrono::duration<double>(clock::now() - start_time).count();
+}
+
+double TimeManager::soft() const
+{
+  std::lock_guard<std::mutex> guard(limits_lock);
+  return std::chrono::duration<double>(soft_limit).count();
+}
+
+double TimeManager::hard() const
+{
+  std::lock_guard<std::mutex> guard(limits_lock);
+  return std::chrono::duration<double>(hard_limit).count();
+}
+
+}
+
+}
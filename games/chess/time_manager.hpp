@@ -0,0 +1,116 @@
+////////////////////////////////////////////////////////////////////// 
+/// @file time_manager.hpp 
+/// @author Shawn McCormick CS5400
+/// @brief Allocates search time from the player's remaining clock
+////////////////////////////////////////////////////////////////////// 
+
+#ifndef TIME_MANAGER_HPP
+#define TIME_MANAGER_HPP
+
+#include <atomic>
+#include <chrono>
+#include <mutex>
+
+typedef unsigned long long U64;
+
+namespace cpp_client
+{
+
+namespace chess
+{
+
+////////////////////////////////////////////////////////////////////// 
+/// @class TimeManager 
+/// @brief Soft and hard deadlines for a single search
+///
+/// The soft limit decides whether another iteration is worth starting,
+/// and may be extended when the search looks unsettled, up to the hard
+/// limit. The hard limit is polled from inside the search and aborts it
+/// mid-iteration, wasting that iteration, so it is kept for emergencies.
+///
+/// The start functions must be called before the search begins. adopt()
+/// and abort() may be called from another thread while it runs.
+////////////////////////////////////////////////////////////////////// 
+class TimeManager {
+  public:
+    using clock = std::chrono::steady_clock;
+
+    // Nodes searched between clock reads
+    static const U64 CHECK_INTERVAL = 1024;
+
+  private:
+    mutable std::mutex limits_lock; // Guards the time point and limits below
+    clock::time_point start_time; // When the search began
+    clock::time_point limits_from; // When the limits started counting; later than start_time after adopt()
+    clock::duration soft_limit; // Time after which no new iteration is started
+    clock::duration hard_limit; // Time after which the search is aborted
+    clock::duration max_soft; // Cap on extensions of the soft limit
+    U64 node_count; // Nodes searched so far; only touched by the searching thread
+    std::atomic<bool> stop; // Whether the search has been aborted
+
+    // Replace the limits, timing them from now
+    void set_limits(double soft, double hard);
+
+    // Compute soft and hard limits, in seconds, from the player's clock
+    static void allocate(double time_remaining, int turn, int max_turns, double& soft, double& hard);
+
+  public:
+    TimeManager();
+
+    // Allocate the time for this turn
+    // Parameters:
+    //      double time_remaining: Nanoseconds left on the player's clock
+    //      int turn: The current turn number, starting at 0
+    //      int max_turns: The turn at which the game ends
+    void start(double time_remaining, int turn, int max_turns);
+
+    // Use fixed limits for this search
+    // Parameters:
+    //      double soft: Seconds after which no new iteration is started
+    //      double hard: Seconds after which the search is aborted
+    void start_fixed(double soft, double hard);
+
+    // Search without limits until adopt() or abort() is called; used when pondering
+    void start_infinite();
+
+    // Give a running search the limits start() would have, timing them from now
+    //      elapsed() still counts from the start of the search
+    // Parameters: as for start()
+    void adopt(double time_remaining, int turn, int max_turns);
+
+    // Stop the search at its next check
+    void abort() { stop = true; }
+
+    // Count a node and check the hard deadline every CHECK_INTERVAL nodes
+    // Returns true if the search should abort
+    bool should_stop();
+
+    // Whether the search was aborted by the hard deadline or abort()
+    bool stopped() const { return stop; }
+
+    // Whether there is time to start another iteration: an iteration takes
+    // longer than all before it, so none starts unless that much time is left
+    // before the soft limit
+    bool can_start_iteration() const;
+
+    // Give the search more time, up to a fixed multiple of the original soft limit and never past the hard limit
+    // Parameters:
+    //      double factor: Multiplier for the soft limit
+    void extend(double factor);
+
+    // Seconds since the search started
+    double elapsed() const;
+
+    // The soft and hard limits, in seconds
+    double soft() const;
+    double hard() const;
+
+    // Nodes counted since start()
+    U64 nodes() const { return node_count; }
+};
+
+}
+
+}
+
+#endif
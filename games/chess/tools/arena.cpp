@@ -0,0 +1,418 @@
+//////////////////////////////////////////////////////////////////////
+/// @file arena.cpp
+/// @author Shawn McCormick CS5400
+/// @brief Plays two engine configurations against each other in-process
+///
+/// Each configuration is written like --aiSettings, e.g.
+/// "name=new&depth=20&quiescence=4&book=book.bin". Games start from an
+/// opening set, each opening played twice with colors swapped, and run
+/// on several threads at once under a time control. After every game
+/// the match is tested with a sequential probability ratio test, so it
+/// stops as soon as the result is clear either way.
+//////////////////////////////////////////////////////////////////////
+
+#include "tclap/CmdLine.h"
+#include "../bitbase.hpp"
+#include "../book.hpp"
+#include "../custom_board.hpp"
+#include "../engine_settings.hpp"
+#include "../eval_cache.hpp"
+#include "../search.hpp"
+#include "../tablebase.hpp"
+#include "../time_manager.hpp"
+
+#include <atomic>
+#include <chrono>
+#include <cmath>
+#include <fstream>
+#include <iostream>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <sstream>
+#include <stdexcept>
+#include <thread>
+
+using namespace cpp_client::chess;
+
+const char START_FEN[] = "rnbqkbnr/pppppppp/8/8/8/8/PPPPPPPP/RNBQKBNR w KQkq - 0 1";
+
+// Openings used when no EPD file is given, as moves from the start position
+const char* const OPENING_LINES[] = {
+    "e2e4 e7e5 g1f3 b8c6 f1b5 a7a6",
+    "e2e4 c7c5 g1f3 d7d6 d2d4 c5d4",
+    "e2e4 e7e6 d2d4 d7d5 b1c3 g8f6",
+    "e2e4 c7c6 d2d4 d7d5 b1c3 d5e4",
+    "d2d4 d7d5 c2c4 e7e6 b1c3 g8f6",
+    "d2d4 g8f6 c2c4 g7g6 b1c3 f8g7",
+    "d2d4 g8f6 c2c4 e7e6 g1f3 b7b6",
+    "c2c4 e7e5 b1c3 g8f6 g1f3 b8c6",
+    "g1f3 d7d5 g2g3 g8f6 f1g2 c7c6",
+    "e2e4 d7d5 e4d5 d8d5 b1c3 d5a5",
+};
+
+//////////////////////////////////////////////////////////////////////
+/// @class EngineConfig
+/// @brief One side's settings, parsed from an --aiSettings-style string
+///
+/// Besides name=<label> for the results, the keys are the client's own
+/// EngineSettings. The arena never ponders or writes statistics, so it
+/// accepts but ignores ponder and stats.
+//////////////////////////////////////////////////////////////////////
+struct EngineConfig {
+    std::string name;
+    EngineSettings settings;
+
+    explicit EngineConfig(const std::string& text);
+};
+
+EngineConfig::EngineConfig(const std::string& text)
+  : name(text.empty() ? "default" : text)
+{
+  std::istringstream pairs(text);
+  std::string setting;
+  while (std::getline(pairs, setting, '&'))
+  {
+    std::size_t equals = setting.find('=');
+    if (equals == std::string::npos)
+      throw std::invalid_argument("Could not find '=' in engine setting \"" + setting + "\"");
+    std::string key = setting.substr(0, equals);
+    std::string value = setting.substr(equals + 1);
+    if (key == "name")
+      name = value;
+    else if (!settings.set(key, value))
+      throw std::invalid_argument("Unknown engine setting \"" + key + "\"");
+  }
+}
+
+//////////////////////////////////////////////////////////////////////
+/// @class Engine
+/// @brief One side's configuration and its own tables
+///
+/// Each thread makes one Engine per side and reuses it for every game
+/// it plays, clearing the tables between games, so the tables are
+/// allocated once per thread rather than once per game.
+//////////////////////////////////////////////////////////////////////
+struct Engine {
+    const EngineConfig& config;
+    SearchTables tables;
+    EvalCache cache;
+    TimeManager timer;
+    OpeningBook book;
+    Tablebases tablebases;
+
+    explicit Engine(const EngineConfig& config_) : config(config_)
+    {
+      if (!config.settings.book.empty() && !book.open(config.settings.book))
+        throw std::invalid_argument("Could not open opening book " + config.settings.book);
+      if (config.settings.probe)
+        tables.tablebases = &tablebases;
+    }
+
+    Engine(const Engine&) = delete;
+    Engine& operator=(const Engine&) = delete;
+
+    // Forget the previous game, as a fresh client would
+    void new_game()
+    {
+      tables.clear();
+      cache.clear();
+    }
+
+    // Choose a move as AI::run_turn would: from the book, else by searching
+    // Parameters:
+    //      double remaining: Seconds left on this side's clock
+    MyMove choose(State& state, double remaining, int turn, int max_turns)
+    {
+      MyMove move;
+      if (book.is_open() && book.choose(state, config.settings.book_best, move))
+        return move;
+      state.set_root_player(state.player_to_move());
+      tables.new_search();
+      timer.start(remaining * 1e9, turn, max_turns);
+      return tliddlmm(state, tables, cache, timer, config.settings.depth, config.settings.quiescence);
+    }
+};
+
+// The match settings shared by every game
+struct Match {
+    EngineConfig engines[2];
+    std::vector<std::string> openings; // FENs
+    double time; // Seconds on each clock at the start
+    double increment; // Seconds added after each move
+    int max_plies; // Plies after which a game is drawn
+};
+
+// A finished game's result, from the first engine's perspective
+enum Outcome { LOSS, DRAWN, WIN };
+
+// Play one game
+// Parameters:
+//      Engine& first, Engine& second: The engines for match.engines[0] and [1]; cleared first
+//      bool first_white: Whether the first engine has white
+//      std::string& reason: Set to why the game ended
+Outcome play(const Match& match, Engine& first, Engine& second, const std::string& fen, bool first_white, std::string& reason)
+{
+  first.new_game();
+  second.new_game();
+  Engine* sides[2] = {first_white ? &first : &second, first_white ? &second : &first};
+  double clocks[2] = {match.time, match.time};
+
+  State state = State::from_fen(fen);
+  for (int ply = 0; ply < match.max_plies; ply++)
+  {
+    bool mover = state.player_to_move();
+    // The result of the game for the first engine, if the player to move loses
+    Outcome mover_loses = ((mover == 0) == first_white ? LOSS : WIN);
+
+    if (!state.actions_exist())
+    {
+      reason = (state.in_check() ? "checkmate" : "stalemate");
+      return (state.in_check() ? mover_loses : DRAWN);
+    }
+    if (state.stalemate())
+    {
+      reason = "draw by rule";
+      return DRAWN;
+    }
+
+    auto start = std::chrono::steady_clock::now();
+    MyMove move = sides[mover]->choose(state, clocks[mover], ply, match.max_plies);
+    clocks[mover] -= std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+    if (clocks[mover] < 0)
+    {
+      reason = "time forfeit";
+      return mover_loses;
+    }
+    clocks[mover] += match.increment;
+
+    // The moved state owns what the move displaced
+    for (auto displaced : state.APPLY(move))
+      delete displaced.second;
+  }
+  reason = "ply limit";
+  return DRAWN;
+}
+
+// Expected score of the stronger side at an Elo difference
+double expected_score(double elo)
+{
+  return 1 / (1 + std::pow(10.0, -elo / 400));
+}
+
+// Running totals and the statistics drawn from them
+struct Tally {
+    int results[3]; // Indexed by Outcome
+    int played() const { return results[LOSS] + results[DRAWN] + results[WIN]; }
+
+    // Mean score per game for the first engine
+    double score() const { return (results[WIN] + 0.5 * results[DRAWN]) / played(); }
+
+    // Variance of one game's score
+    double variance() const
+    {
+      double mean = score();
+      return (results[WIN] * std::pow(1 - mean, 2) + results[DRAWN] * std::pow(0.5 - mean, 2)
+              + results[LOSS] * std::pow(mean, 2)) / played();
+    }
+
+    // Elo difference of a score, clamped away from the infinities at 0 and 1
+    static double elo(double score)
+    {
+      score = std::min(std::max(score, 1e-3), 1 - 1e-3);
+      return -400 * std::log10(1 / score - 1);
+    }
+
+    // Log-likelihood ratio of elo1 over elo0, by the normal approximation to the score
+    double llr(double elo0, double elo1) const
+    {
+      if (played() == 0)
+        return 0;
+      double variance_of_mean = variance() / played();
+      if (variance_of_mean <= 0)
+        return 0;
+      double s0 = expected_score(elo0), s1 = expected_score(elo1);
+      return (s1 - s0) * (2 * score() - s0 - s1) / (2 * variance_of_mean);
+    }
+};
+
+// Read openings from an EPD file; only the first four fields of each line are used
+std::vector<std::string> read_openings(const std::string& path)
+{
+  std::vector<std::string> openings;
+  std::ifstream in(path);
+  if (!in)
+    throw std::invalid_argument("Could not open " + path);
+  std::string line;
+  while (std::getline(in, line))
+  {
+    std::istringstream fields(line);
+    std::string board, side, castling, en_passant;
+    if (!(fields >> board >> side >> castling >> en_passant) || board[0] == '#')
+      continue;
+    std::string fen = board + " " + side + " " + castling + " " + en_passant + " 0 1";
+    State::from_fen(fen); // Reject bad positions before any game starts
+    openings.push_back(fen);
+  }
+  return openings;
+}
+
+// The built-in openings as FENs
+std::vector<std::string> default_openings()
+{
+  std::vector<std::string> openings;
+  for (const char* line : OPENING_LINES)
+  {
+    State state = State::from_fen(START_FEN);
+    std::istringstream moves(line);
+    std::string uci;
+    while (moves >> uci)
+    {
+      bool played = false;
+      for (const MyMove& action : state.ACTIONS())
+      {
+        if (action.uci() == uci)
+        {
+          for (auto displaced : state.APPLY(action))
+            delete displaced.second;
+          played = true;
+          break;
+        }
+      }
+      if (!played)
+        throw std::invalid_argument("Illegal move " + uci + " in built-in opening " + line);
+    }
+    openings.push_back(state.to_fen());
+  }
+  return openings;
+}
+
+int main(int argc, const char* argv[])
+{
+  try
+  {
+    TCLAP::CmdLine cmd("Plays two engine configurations against each other and tests the result with SPRT.");
+    TCLAP::ValueArg<std::string> first_arg("a", "first", "The engine being tested, as --aiSettings", false, "name=first", "settings");
+    TCLAP::ValueArg<std::string> second_arg("b", "second", "The engine it is tested against, as --aiSettings", false, "name=second", "settings");
+    TCLAP::ValueArg<std::string> openings_arg("o", "openings", "An EPD file of starting positions", false, "", "path");
+    TCLAP::ValueArg<int> games_arg("g", "games", "The most games to play", false, 1000, "int");
+    TCLAP::ValueArg<int> threads_arg("j", "threads", "Games to play at once; 0 for one per core", false, 0, "int");
+    TCLAP::ValueArg<double> time_arg("t", "time", "Seconds on each clock", false, 60, "seconds");
+    TCLAP::ValueArg<double> increment_arg("i", "increment", "Seconds added to a clock after each move", false, 0, "seconds");
+    TCLAP::ValueArg<int> plies_arg("p", "max-plies", "Plies after which a game is drawn", false, 400, "int");
+    TCLAP::ValueArg<double> elo0_arg("", "elo0", "SPRT null hypothesis: the Elo gain is at most this", false, 0, "Elo");
+    TCLAP::ValueArg<double> elo1_arg("", "elo1", "SPRT alternative: the Elo gain is at least this", false, 5, "Elo");
+    TCLAP::ValueArg<double> alpha_arg("", "alpha", "SPRT false positive rate", false, 0.05, "rate");
+    TCLAP::ValueArg<double> beta_arg("", "beta", "SPRT false negative rate", false, 0.05, "rate");
+    cmd.add(first_arg);
+    cmd.add(second_arg);
+    cmd.add(openings_arg);
+    cmd.add(games_arg);
+    cmd.add(threads_arg);
+    cmd.add(time_arg);
+    cmd.add(increment_arg);
+    cmd.add(plies_arg);
+    cmd.add(elo0_arg);
+    cmd.add(elo1_arg);
+    cmd.add(alpha_arg);
+    cmd.add(beta_arg);
+    cmd.parse(argc, argv);
+
+    Match match{{EngineConfig(first_arg.getValue()), EngineConfig(second_arg.getValue())},
+                (openings_arg.getValue().empty() ? default_openings() : read_openings(openings_arg.getValue())),
+                time_arg.getValue(), increment_arg.getValue(), plies_arg.getValue()};
+    if (match.openings.empty())
+      throw std::invalid_argument("No openings in " + openings_arg.getValue());
+
+    // BITBASES is a global that main owns, not either engine: it is filled here before any
+    // thread starts and only read during the games, so no locking is needed.
+    // There is one for the process, so the engines share whichever cache either names
+    const EngineSettings& a = match.engines[0].settings;
+    const EngineSettings& b = match.engines[1].settings;
+    const std::string& cache = (a.bitbases.empty() ? b.bitbases : a.bitbases);
+    if (cache.empty() || !BITBASES.load(cache))
+    {
+      BITBASES.generate();
+      if (!cache.empty() && !BITBASES.save(cache))
+        std::cerr << "Could not write bitbase cache " << cache << std::endl;
+    }
+
+    const double lower = std::log(beta_arg.getValue() / (1 - alpha_arg.getValue()));
+    const double upper = std::log((1 - beta_arg.getValue()) / alpha_arg.getValue());
+    const std::string& first = match.engines[0].name;
+    const std::string& second = match.engines[1].name;
+
+    Tally tally = {{0, 0, 0}};
+    std::mutex lock;
+    std::atomic<int> next_game(0);
+    std::atomic<bool> decided(false);
+
+    unsigned threads = std::max(1u, threads_arg.getValue() > 0 ? threads_arg.getValue() : std::thread::hardware_concurrency());
+
+    // Each thread's pair of engines, made before any game so a bad setting stops the match at once
+    std::vector<std::unique_ptr<Engine>> engines;
+    for (unsigned t = 0; t < threads; t++)
+    {
+      engines.emplace_back(new Engine(match.engines[0]));
+      engines.emplace_back(new Engine(match.engines[1]));
+    }
+
+    // Each thread plays games until the games run out or SPRT decides
+    auto worker = [&](unsigned t)
+    {
+      Engine& first_engine = *engines[2 * t];
+      Engine& second_engine = *engines[2 * t + 1];
+      for (int game = next_game++; game < games_arg.getValue() && !decided; game = next_game++)
+      {
+        // Each opening is played twice, once with each color
+        const std::string& fen = match.openings[(game / 2) % match.openings.size()];
+        bool first_white = (game % 2 == 0);
+        std::string reason;
+        Outcome outcome = play(match, first_engine, second_engine, fen, first_white, reason);
+
+        std::lock_guard<std::mutex> guard(lock);
+        tally.results[outcome]++;
+        double llr = tally.llr(elo0_arg.getValue(), elo1_arg.getValue());
+        std::cout << "game " << game + 1 << ": " << (first_white ? first + " - " + second : second + " - " + first)
+                  << " " << (outcome == DRAWN ? "1/2-1/2" : (outcome == WIN) == first_white ? "1-0" : "0-1")
+                  << " (" << reason << ")  +" << tally.results[WIN] << " =" << tally.results[DRAWN]
+                  << " -" << tally.results[LOSS] << "  llr " << llr << std::endl;
+        if (llr <= lower || llr >= upper)
+          decided = true;
+      }
+    };
+
+    std::vector<std::thread> workers;
+    for (unsigned t = 0; t < threads; t++)
+      workers.push_back(std::thread(worker, t));
+    for (std::thread& thread : workers)
+      thread.join();
+
+    if (tally.played() == 0)
+      return 0;
+
+    // 95% confidence interval of the score, mapped to Elo
+    double margin = 1.96 * std::sqrt(tally.variance() / tally.played());
+    double llr = tally.llr(elo0_arg.getValue(), elo1_arg.getValue());
+    std::cout << std::endl
+              << first << " vs " << second << ": +" << tally.results[WIN] << " =" << tally.results[DRAWN]
+              << " -" << tally.results[LOSS] << " in " << tally.played() << " games" << std::endl
+              << "Score: " << tally.score() * 100 << "%" << std::endl
+              << "Elo:   " << Tally::elo(tally.score()) << " [" << Tally::elo(tally.score() - margin)
+              << ", " << Tally::elo(tally.score() + margin) << "]" << std::endl
+              << "SPRT:  elo0 " << elo0_arg.getValue() << " elo1 " << elo1_arg.getValue()
+              << ", llr " << llr << " [" << lower << ", " << upper << "]: "
+              << (llr >= upper ? "H1 accepted" : llr <= lower ? "H0 accepted" : "inconclusive") << std::endl;
+  }
+  catch(TCLAP::ArgException& e)
+  {
+    std::cerr << "error: " << e.error() << " for arg " << e.argId() << std::endl;
+    return 1;
+  }
+  catch(std::invalid_argument& e)
+  {
+    std::cerr << "error: " << e.what() << std::endl;
+    return 1;
+  }
+  return 0;
+}
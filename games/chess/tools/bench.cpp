@@ -0,0 +1,120 @@
+//////////////////////////////////////////////////////////////////////
+/// @file bench.cpp
+/// @author Shawn McCormick CS5400
+/// @brief Fixed-depth search benchmark over a set of positions
+///
+/// Every position is searched to the same depth with fresh tables, so the
+/// total node count is a signature of the search's behavior: a refactor
+/// that should not change the search must not change it. The nodes per
+/// second track the search's speed between commits.
+//////////////////////////////////////////////////////////////////////
+
+#include "tclap/CmdLine.h"
+#include "../custom_board.hpp"
+#include "../eval_cache.hpp"
+#include "../search.hpp"
+#include "../time_manager.hpp"
+
+#include <fstream>
+#include <iostream>
+#include <stdexcept>
+
+using namespace cpp_client::chess;
+
+// Openings, middlegames and endgames with a spread of branching factors
+const char* const BENCH_FENS[] = {
+    "rnbqkbnr/pppppppp/8/8/8/8/PPPPPPPP/RNBQKBNR w KQkq - 0 1",
+    "r3k2r/p1ppqpb1/bn2pnp1/3PN3/1p2P3/2N2Q1p/PPPBBPPP/R3K2R w KQkq - 0 1",
+    "r1bqkbnr/pppp1ppp/2n5/4p3/4P3/5N2/PPPP1PPP/RNBQKB1R w KQkq - 2 3",
+    "r4rk1/1pp1qppp/p1np1n2/2b1p1B1/2B1P1b1/P1NP1N2/1PP1QPPP/R4RK1 w - - 0 10",
+    "rnbq1k1r/pp1Pbppp/2p5/8/2B5/8/PPP1NnPP/RNBQK2R w KQ - 1 8",
+    "r3k2r/Pppp1ppp/1b3nbN/nP6/BBP1P3/q4N2/Pp1P2PP/R2Q1RK1 w kq - 0 1",
+    "2r3k1/pp3ppp/8/3R4/8/8/PP3PPP/6K1 w - - 0 1",
+    "8/2p5/3p4/KP5r/1R3p1k/8/4P1P1/8 w - - 0 1",
+    "8/8/4k3/8/2P5/4K3/8/8 w - - 0 1",
+    "6k1/5ppp/8/8/8/8/5PPP/3Q2K1 w - - 0 1",
+};
+
+// Search one position to a fixed depth, printing its nodes, time and speed
+// Parameters:
+//      double& elapsed: Set to the seconds spent searching, excluding table setup
+// Returns the number of nodes searched
+U64 bench_position(const std::string& fen, int depth, int quiescence, double& elapsed)
+{
+  State state = State::from_fen(fen);
+
+  // Fresh tables and move shuffling for every position, so each count is
+  // independent of the positions before it
+  SearchTables tables;
+  EvalCache cache;
+  TimeManager timer;
+  State::seed_shuffle(1);
+
+  timer.start_infinite();
+  MyMove best = tliddlmm(state, tables, cache, timer, depth, quiescence);
+  elapsed = timer.elapsed();
+  U64 nodes = timer.nodes();
+
+  std::cout << fen << std::endl
+            << "  best " << best.uci() << "  nodes " << nodes << "  time " << elapsed << " s  nps "
+            << (elapsed > 0 ? static_cast<U64>(nodes / elapsed) : 0) << std::endl
+            << "  " << stats_line(0, tables.iterations, "") << std::endl;
+  return nodes;
+}
+
+int main(int argc, const char* argv[])
+{
+  try
+  {
+    TCLAP::CmdLine cmd("Searches a set of positions to a fixed depth and reports nodes and speed.");
+    TCLAP::ValueArg<int> depth_arg("d", "depth", "Plies to search each position to", false, 5, "int");
+    TCLAP::ValueArg<int> quiescence_arg("q", "quiescence", "Quiescence depth increases allowed", false, 3, "int");
+    TCLAP::ValueArg<std::string> file_arg("f", "file", "A file of FENs, one per line, to search instead of the built-in set", false, "", "path");
+    cmd.add(depth_arg);
+    cmd.add(quiescence_arg);
+    cmd.add(file_arg);
+    cmd.parse(argc, argv);
+
+    std::vector<std::string> fens;
+    if (file_arg.getValue().empty())
+      fens.assign(std::begin(BENCH_FENS), std::end(BENCH_FENS));
+    else
+    {
+      std::ifstream file(file_arg.getValue());
+      if (!file)
+        throw std::invalid_argument("Could not open " + file_arg.getValue());
+      std::string line;
+      while (std::getline(file, line))
+      {
+        if (!line.empty() && line[0] != '#')
+          fens.push_back(line);
+      }
+    }
+
+    U64 total = 0;
+    double elapsed = 0;
+    for (const std::string& fen : fens)
+    {
+      double seconds;
+      total += bench_position(fen, depth_arg.getValue(), quiescence_arg.getValue(), seconds);
+      elapsed += seconds;
+    }
+
+    std::cout << std::endl
+              << "Positions: " << fens.size() << std::endl
+              << "Nodes:     " << total << std::endl
+              << "Time:      " << elapsed << " s" << std::endl
+              << "NPS:       " << (elapsed > 0 ? static_cast<U64>(total / elapsed) : 0) << std::endl;
+  }
+  catch(TCLAP::ArgException& e)
+  {
+    std::cerr << "error: " << e.error() << " for arg " << e.argId() << std::endl;
+    return 1;
+  }
+  catch(std::invalid_argument& e)
+  {
+    std::cerr << "error: " << e.what() << std::endl;
+    return 1;
+  }
+  return 0;
+}
@@ -0,0 +1,406 @@
+//////////////////////////////////////////////////////////////////////
+/// @file book_builder.cpp
+/// @author Shawn McCormick CS5400
+/// @brief Builds a Polyglot opening book from game collections
+///
+/// Games are read from PGN files, which may also hold self-play games
+/// written with coordinate moves, and EPD files, whose "bm" operations
+/// each count as one won game for the side to move. Every game is
+/// replayed through State::APPLY and UNDO to a fixed ply. The results are
+/// summed per (polyglot_key, move), and the totals are written as a
+/// sorted book that OpeningBook can map. The games are split across
+/// threads, each with its own totals, merged at the end.
+//////////////////////////////////////////////////////////////////////
+
+#include "tclap/CmdLine.h"
+#include "../book.hpp"
+#include "../custom_board.hpp"
+
+#include <algorithm>
+#include <cctype>
+#include <cstring>
+#include <fstream>
+#include <iostream>
+#include <map>
+#include <sstream>
+#include <stdexcept>
+#include <thread>
+
+using namespace cpp_client::chess;
+
+const char START_FEN[] = "rnbqkbnr/pppppppp/8/8/8/8/PPPPPPPP/RNBQKBNR w KQkq - 0 1";
+
+// A game to replay
+struct GameRecord {
+    std::string source; // File and game number, for warnings
+    std::string fen; // The starting position
+    std::vector<std::string> moves; // Moves in SAN or coordinate notation
+    int result; // {1 white won, 0 draw, -1 black won}
+    bool alternatives; // Whether moves are all candidates from fen, as in EPD, instead of a line
+};
+
+// Results of one move from one position, from the mover's perspective
+struct MoveStats {
+    unsigned games;
+    unsigned wins;
+    unsigned draws;
+};
+
+typedef std::map<std::pair<U64, uint16_t>, MoveStats> BookStats;
+
+// Find the legal move written in SAN or coordinate notation
+// Returns false if no legal move, or more than one, matches
+bool find_move(State& state, const std::string& written, MyMove& found)
+{
+  // Drop check, mate and annotation marks
+  std::string text = written;
+  while (!text.empty() && std::strchr("+#!?", text.back()) != nullptr)
+    text.pop_back();
+  if (text.empty())
+    return false;
+
+  std::vector<MyMove> actions = state.ACTIONS();
+
+  // Coordinate notation, as self-play games are written
+  for (const MyMove& action : actions)
+  {
+    if (action.uci() == text)
+    {
+      found = action;
+      return true;
+    }
+  }
+
+  // Castling
+  if (text == "O-O" || text == "0-0" || text == "O-O-O" || text == "0-0-0")
+  {
+    char file2 = (text.size() == 3 ? 'g' : 'c');
+    for (const MyMove& action : actions)
+    {
+      if (action.move_type == "Castle" && action.file2 == file2)
+      {
+        found = action;
+        return true;
+      }
+    }
+    return false;
+  }
+
+  // Promotion, written "e8=Q" or "e8Q"
+  PieceType promotion = NO_PIECE;
+  if (std::isupper(text.back()))
+  {
+    promotion = piece_from_symbol(text.back());
+    text.pop_back();
+    if (!text.empty() && text.back() == '=')
+      text.pop_back();
+  }
+
+  PieceType type = PAWN;
+  if (!text.empty() && std::isupper(text[0]))
+  {
+    type = piece_from_symbol(text[0]);
+    text.erase(0, 1);
+  }
+  text.erase(std::remove(text.begin(), text.end(), 'x'), text.end());
+  if (text.size() < 2 || type == NO_PIECE)
+    return false;
+
+  // The target tile is last; anything before it narrows the starting tile
+  char file2 = text[text.size() - 2];
+  int rank2 = text.back() - '0';
+  char from_file = 0;
+  int from_rank = 0;
+  for (std::size_t k = 0; k + 2 < text.size(); k++)
+  {
+    if ('a' <= text[k] && text[k] <= 'h')
+      from_file = text[k];
+    else if ('1' <= text[k] && text[k] <= '8')
+      from_rank = text[k] - '0';
+    else
+      return false;
+  }
+
+  int matches = 0;
+  for (const MyMove& action : actions)
+  {
+    if (action.file2 == file2 && action.rank2 == rank2 && action.promotion == promotion
+        && state.getPiece(action.file, action.rank)->type == type
+        && (from_file == 0 || action.file == from_file) && (from_rank == 0 || action.rank == from_rank))
+    {
+      found = action;
+      matches++;
+    }
+  }
+  return matches == 1;
+}
+
+// The value of a PGN tag line such as [Result "1-0"]
+std::string tag_value(const std::string& line)
+{
+  std::size_t open = line.find('"');
+  std::size_t close = line.rfind('"');
+  return (open == std::string::npos || close <= open ? "" : line.substr(open + 1, close - open - 1));
+}
+
+// Read every game with a decisive or drawn result from a PGN file
+void read_pgn(const std::string& path, std::istream& in, std::vector<GameRecord>& games)
+{
+  GameRecord game{"", START_FEN, {}, 0, false};
+  int count = 0;
+  int depth = 0; // Nesting of variations and comments being skipped
+  std::string line;
+
+  while (std::getline(in, line))
+  {
+    if (depth == 0 && !line.empty() && line[0] == '[')
+    {
+      if (line.compare(0, 5, "[FEN ") == 0)
+        game.fen = tag_value(line);
+      continue;
+    }
+
+    std::istringstream tokens(line);
+    std::string token;
+    while (tokens >> token)
+    {
+      // Comments and variations can span lines and, for variations, nest
+      if (depth > 0 || token[0] == '{' || token[0] == '(')
+      {
+        for (char c : token)
+          depth += (c == '{' || c == '(') - (c == '}' || c == ')');
+        continue;
+      }
+      if (token[0] == ';')
+        break;
+      if (token[0] == '$')
+        continue;
+
+      bool finished = true;
+      if (token == "1-0")
+        game.result = 1;
+      else if (token == "0-1")
+        game.result = -1;
+      else if (token == "1/2-1/2")
+        game.result = 0;
+      else if (token == "*")
+        game.moves.clear(); // Unfinished games say nothing about their moves
+      else
+        finished = false;
+
+      if (finished)
+      {
+        game.source = path + " game " + std::to_string(++count);
+        if (!game.moves.empty())
+          games.push_back(game);
+        game = GameRecord{"", START_FEN, {}, 0, false};
+        continue;
+      }
+
+      // Move numbers end in a dot and may be attached to the move, as in "1.e4" or "3...Nf6";
+      // a token without one is a move, even "0-0"
+      std::size_t dot = token.rfind('.');
+      if (dot == std::string::npos)
+        game.moves.push_back(token);
+      else if (dot + 1 < token.size())
+        game.moves.push_back(token.substr(dot + 1));
+    }
+  }
+}
+
+// Read every position with a best move from an EPD file
+void read_epd(const std::string& path, std::istream& in, std::vector<GameRecord>& games)
+{
+  std::string line;
+  int count = 0;
+  while (std::getline(in, line))
+  {
+    count++;
+    std::istringstream fields(line);
+    std::string board, side, castling, en_passant;
+    if (!(fields >> board >> side >> castling >> en_passant))
+      continue;
+
+    GameRecord game{path + " line " + std::to_string(count), board + " " + side + " " + castling + " " + en_passant,
+                    {}, (side == "w" ? 1 : -1), true};
+    std::string operation;
+    while (fields >> operation)
+    {
+      if (operation != "bm")
+        continue;
+      std::string move;
+      while (fields >> move)
+      {
+        bool last = (move.back() == ';');
+        if (last)
+          move.pop_back();
+        game.moves.push_back(move);
+        if (last)
+          break;
+      }
+    }
+    if (!game.moves.empty())
+      games.push_back(game);
+  }
+}
+
+// Add a move's result to the totals
+void count(BookStats& stats, U64 key, const MyMove& move, int result, bool mover)
+{
+  MoveStats& totals = stats[std::make_pair(key, polyglot_move(move))];
+  totals.games++;
+  if (result == 0)
+    totals.draws++;
+  else if ((result > 0) == (mover == 0))
+    totals.wins++;
+}
+
+// Replay games[first, last) into stats, stopping each game after plies moves
+void replay(const std::vector<GameRecord>& games, std::size_t first, std::size_t last, int plies, BookStats& stats)
+{
+  for (std::size_t g = first; g < last; g++)
+  {
+    const GameRecord& game = games[g];
+    try
+    {
+      State state = State::from_fen(game.fen);
+      std::vector<std::pair<MyMove, std::vector<std::pair<pair, MyPiece*>>>> played;
+
+      for (const std::string& written : game.moves)
+      {
+        if (!game.alternatives && static_cast<int>(played.size()) >= plies)
+          break;
+        MyMove move;
+        if (!find_move(state, written, move))
+        {
+          std::cerr << "warning: " << game.source << ": cannot play \"" << written << "\"" << std::endl;
+          break;
+        }
+        count(stats, polyglot_key(state), move, game.result, state.player_to_move());
+        if (!game.alternatives)
+          played.push_back(std::make_pair(move, state.APPLY(move)));
+      }
+
+      // UNDO frees the pieces APPLY displaced
+      for (auto it = played.rbegin(); it != played.rend(); ++it)
+        state.UNDO(it->second);
+    }
+    catch(std::invalid_argument& e)
+    {
+      std::cerr << "warning: " << game.source << ": " << e.what() << std::endl;
+    }
+  }
+}
+
+int main(int argc, const char* argv[])
+{
+  try
+  {
+    TCLAP::CmdLine cmd("Builds a Polyglot opening book from PGN, EPD and self-play game files.");
+    TCLAP::ValueArg<std::string> output_arg("o", "output", "The book file to write", false, "book.bin", "path");
+    TCLAP::ValueArg<int> plies_arg("p", "plies", "Plies of each game to add to the book", false, 20, "int");
+    TCLAP::ValueArg<int> min_games_arg("m", "min-games", "Games a move must appear in to be kept", false, 2, "int");
+    TCLAP::ValueArg<int> threads_arg("j", "threads", "Threads to replay games on; 0 for one per core", false, 0, "int");
+    TCLAP::UnlabeledMultiArg<std::string> files_arg("files", "PGN files, or EPD files ending in .epd", true, "path");
+    cmd.add(output_arg);
+    cmd.add(plies_arg);
+    cmd.add(min_games_arg);
+    cmd.add(threads_arg);
+    cmd.add(files_arg);
+    cmd.parse(argc, argv);
+
+    std::vector<GameRecord> games;
+    for (const std::string& path : files_arg.getValue())
+    {
+      std::ifstream in(path);
+      if (!in)
+        throw std::invalid_argument("Could not open " + path);
+      bool epd = (path.size() >= 4 && path.compare(path.size() - 4, 4, ".epd") == 0);
+      if (epd)
+        read_epd(path, in, games);
+      else
+        read_pgn(path, in, games);
+    }
+
+    unsigned threads = (threads_arg.getValue() > 0 ? threads_arg.getValue() : std::thread::hardware_concurrency());
+    threads = std::max(1u, std::min<unsigned>(threads, games.size()));
+
+    // Each thread totals a contiguous share of the games
+    std::vector<BookStats> shares(threads);
+    std::vector<std::thread> workers;
+    for (unsigned t = 0; t < threads; t++)
+    {
+      std::size_t first = games.size() * t / threads;
+      std::size_t last = games.size() * (t + 1) / threads;
+      workers.push_back(std::thread(replay, std::cref(games), first, last, plies_arg.getValue(), std::ref(shares[t])));
+    }
+    for (std::thread& worker : workers)
+      worker.join();
+
+    BookStats stats;
+    for (const BookStats& share : shares)
+    {
+      for (const auto& move : share)
+      {
+        MoveStats& totals = stats[move.first];
+        totals.games += move.second.games;
+        totals.wins += move.second.wins;
+        totals.draws += move.second.draws;
+      }
+    }
+
+    // Weight each move by its points, two for a win and one for a draw;
+    // moves that never scored are left out
+    std::vector<std::pair<BookEntry, U64>> scored;
+    U64 heaviest = 0;
+    for (const auto& move : stats)
+    {
+      U64 points = 2ULL * move.second.wins + move.second.draws;
+      if (static_cast<int>(move.second.games) < min_games_arg.getValue() || points == 0)
+        continue;
+      scored.push_back(std::make_pair(BookEntry{move.first.first, move.first.second, 0, 0}, points));
+      heaviest = std::max(heaviest, points);
+    }
+
+    // Scale into the 16-bit weight, keeping every kept move above zero
+    std::vector<BookEntry> entries;
+    for (auto& move : scored)
+    {
+      U64 weight = (heaviest > 0xFFFF ? move.second * 0xFFFFULL / heaviest : move.second);
+      move.first.weight = static_cast<uint16_t>(std::max<U64>(weight, 1));
+      entries.push_back(move.first);
+    }
+
+    // Polyglot books are sorted by key, and by weight within a key
+    std::sort(entries.begin(), entries.end(), [](const BookEntry& a, const BookEntry& b)
+    {
+      return a.key != b.key ? a.key < b.key : a.weight > b.weight;
+    });
+
+    std::ofstream out(output_arg.getValue(), std::ios::binary);
+    if (!out)
+      throw std::invalid_argument("Could not write " + output_arg.getValue());
+    unsigned char bytes[BOOK_ENTRY_SIZE];
+    for (const BookEntry& entry : entries)
+    {
+      encode_book_entry(entry, bytes);
+      out.write(reinterpret_cast<const char*>(bytes), BOOK_ENTRY_SIZE);
+    }
+
+    std::cout << "Games:   " << games.size() << std::endl
+              << "Threads: " << threads << std::endl
+              << "Moves:   " << stats.size() << std::endl
+              << "Entries: " << entries.size() << " written to " << output_arg.getValue() << std::endl;
+  }
+  catch(TCLAP::ArgException& e)
+  {
+    std::cerr << "error: " << e.error() << " for arg " << e.argId() << std::endl;
+    return 1;
+  }
+  catch(std::invalid_argument& e)
+  {
+    std::cerr << "error: " << e.what() << std::endl;
+    return 1;
+  }
+  return 0;
+}
@@ -0,0 +1,983 @@
+//////////////////////////////////////////////////////////////////////
+/// @file mock_server.cpp
+/// @author Shawn McCormick CS5400
+/// @brief A local stand-in for the game server, for end-to-end runs
+///
+/// Speaks the server's side of the protocol cpp-client uses: alias,
+/// play, lobbied, delta, start, order, run, ran, finished and over, each
+/// message a JSON object followed by a 0x04 byte. Clients asking for the
+/// same session (or "*") are paired into a game. The game's rules come
+/// from State, and every change reaches the clients as a delta against
+/// what they were last sent. Several sessions can run at once, so the
+/// client can be timed under load. Each game ends with a table of per-turn
+/// times: how long the client took to move, how long it took to finish
+/// the turn once the move was acknowledged, and the one-way latency of
+/// its messages by their sentTime.
+//////////////////////////////////////////////////////////////////////
+
+#include "tclap/CmdLine.h"
+#include "netLink.h"
+#include "rapidjson/document.h"
+#include "../custom_board.hpp"
+
+#include <algorithm>
+#include <array>
+#include <cerrno>
+#include <chrono>
+#include <climits>
+#include <iomanip>
+#include <iostream>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <sstream>
+#include <stdexcept>
+#include <thread>
+
+#ifndef WIN32
+#include <poll.h>
+#endif
+
+using namespace cpp_client::chess;
+
+typedef std::chrono::steady_clock Clock;
+
+const char START_FEN[] = "rnbqkbnr/pppppppp/8/8/8/8/PPPPPPPP/RNBQKBNR w KQkq - 0 1";
+
+// Delta constants sent in the lobbied event
+const char LIST_LENGTH[] = "&LEN";
+const char REMOVED[] = "&RM";
+
+// Seconds a new connection has to send alias and play
+const int HANDSHAKE_SECONDS = 30;
+
+// Serializes console output between sessions
+std::mutex print_lock;
+
+// Milliseconds since a time point
+static double ms_since(Clock::time_point start)
+{
+  return std::chrono::duration<double, std::milli>(Clock::now() - start).count();
+}
+
+// A string as a JSON string
+static std::string quote(const std::string& text)
+{
+  std::string quoted = "\"";
+  for (char c : text)
+  {
+    if (c == '"' || c == '\\')
+      quoted += '\\';
+    quoted += c;
+  }
+  return quoted + "\"";
+}
+
+// A reference to a game object
+static std::string reference(int id)
+{
+  return "{\"id\":\"" + std::to_string(id) + "\"}";
+}
+
+// A field of a parsed message, or a default if it is missing or of another type
+static std::string get_string(const rapidjson::Value& object, const char* name, const std::string& missing = "")
+{
+  if (!object.IsObject())
+    return missing;
+  auto member = object.FindMember(name);
+  return (member != object.MemberEnd() && member->value.IsString() ? member->value.GetString() : missing);
+}
+
+// netLink keeps a socket's handle to itself, and its receive never blocks
+// (it only reads what has already arrived), so reach the handle to poll it
+struct Socket_handle : netLink::Socket {
+    static int of(const netLink::Socket& socket) { return socket.*(&Socket_handle::handle); }
+};
+
+// Wait until a socket has bytes to read or its peer hangs up
+// Returns false if the deadline passed first
+static bool wait_readable(const netLink::Socket& socket, Clock::time_point deadline)
+{
+  for (;;)
+  {
+    long long remaining = std::chrono::duration_cast<std::chrono::milliseconds>(deadline - Clock::now()).count() + 1;
+    int timeout = static_cast<int>(std::max(0LL, std::min<long long>(remaining, INT_MAX)));
+#ifdef WIN32
+    WSAPOLLFD fd = {static_cast<SOCKET>(Socket_handle::of(socket)), POLLRDNORM, 0};
+    int ready = WSAPoll(&fd, 1, timeout);
+#else
+    pollfd fd = {Socket_handle::of(socket), POLLIN, 0};
+    int ready = poll(&fd, 1, timeout);
+    if (ready < 0 && errno == EINTR)
+      continue;
+#endif
+    if (ready < 0)
+      throw netLink::Exception(netLink::Exception::ERROR_READ);
+    return ready > 0;
+  }
+}
+
+//////////////////////////////////////////////////////////////////////
+/// @class Client
+/// @brief One client's connection, framed by the 0x04 terminator
+//////////////////////////////////////////////////////////////////////
+class Client {
+  private:
+    std::shared_ptr<netLink::Socket> socket;
+    std::string buffer; // Bytes received past the last message
+    bool print; // Whether to print the traffic
+
+  public:
+    std::string label; // Who the client is, for printing
+
+    Client(std::shared_ptr<netLink::Socket> socket_, bool print_)
+      : socket(socket_), print(print_), label(socket_->hostRemote + ":" + std::to_string(socket_->portRemote)) {}
+
+    // Send a message and its terminator
+    void send(const std::string& message)
+    {
+      if (print)
+      {
+        std::lock_guard<std::mutex> guard(print_lock);
+        std::cout << "TO " << label << " --> " << message << std::endl;
+      }
+      std::string framed = message + '\x04';
+      socket->send(framed.data(), framed.size());
+    }
+
+    // Wait for the next message
+    // Parameters:
+    //      Clock::time_point deadline: When to give up waiting
+    // Returns false if no message arrived in time or the client hung up
+    bool receive(std::string& message, Clock::time_point deadline)
+    {
+      std::array<char, 4096> chunk;
+      std::size_t split;
+      while ((split = buffer.find('\x04')) == std::string::npos)
+      {
+        if (!wait_readable(*socket, deadline))
+          return false;
+        // Readable with nothing to read means the client hung up
+        std::streamsize received = socket->receive(chunk.data(), chunk.size());
+        if (received <= 0)
+          return false;
+        buffer.append(chunk.data(), received);
+      }
+      message = buffer.substr(0, split);
+      buffer.erase(0, split + 1);
+      if (print)
+      {
+        std::lock_guard<std::mutex> guard(print_lock);
+        std::cout << "FROM " << label << " <-- " << message << std::endl;
+      }
+      return true;
+    }
+};
+
+// Per-turn timings of one player, in milliseconds
+struct Timings {
+    std::vector<double> think; // From the order until the move arrived
+    std::vector<double> reply; // From acknowledging the move until the turn was finished
+    std::vector<double> turn; // From the order until the turn was finished; what the clock is charged
+    std::vector<double> transit; // From the client's sentTime until the message was read
+
+    void add(const Timings& other)
+    {
+      think.insert(think.end(), other.think.begin(), other.think.end());
+      reply.insert(reply.end(), other.reply.begin(), other.reply.end());
+      turn.insert(turn.end(), other.turn.begin(), other.turn.end());
+      transit.insert(transit.end(), other.transit.begin(), other.transit.end());
+    }
+};
+
+// Mean, 95th percentile and maximum of some timings
+static std::string summarize(std::vector<double> samples)
+{
+  if (samples.empty())
+    return "-";
+  std::sort(samples.begin(), samples.end());
+  double total = 0;
+  for (double sample : samples)
+    total += sample;
+  std::ostringstream out;
+  out << std::fixed << std::setprecision(2) << total / samples.size() << "/"
+      << samples[samples.size() * 95 / 100] << "/" << samples.back();
+  return out.str();
+}
+
+// Print a table of timings, one row per player
+static void print_timings(const std::vector<std::pair<std::string, Timings>>& rows)
+{
+  std::cout << "  " << std::left << std::setw(20) << "ms: mean/p95/max";
+  for (const char* column : {"think", "reply", "turn", "transit"})
+    std::cout << std::setw(26) << column;
+  std::cout << std::endl;
+  for (const auto& row : rows)
+  {
+    std::cout << "  " << std::setw(20) << row.first.substr(0, 19);
+    for (const std::vector<double>* samples : {&row.second.think, &row.second.reply, &row.second.turn, &row.second.transit})
+      std::cout << std::setw(26) << summarize(*samples);
+    std::cout << std::endl;
+  }
+  std::cout << std::right;
+}
+
+// What a client holds of one object: JSON values and lists of JSON values by field name
+struct Fields {
+    std::map<std::string, std::string> values;
+    std::map<std::string, std::vector<std::string>> lists;
+};
+
+// What a client holds of the whole game
+struct Snapshot {
+    Fields game;
+    std::map<int, Fields> objects; // By id
+};
+
+// The fields of after that differ from before, as JSON members
+//      A changed list is sent with its length and only the entries that changed
+static std::string diff(const Fields& before, const Fields& after)
+{
+  std::string members;
+  auto add = [&members](const std::string& name, const std::string& json)
+  {
+    members += (members.empty() ? "" : ",") + quote(name) + ":" + json;
+  };
+
+  for (const auto& field : after.values)
+  {
+    auto old = before.values.find(field.first);
+    if (old == before.values.end() || old->second != field.second)
+      add(field.first, field.second);
+  }
+  for (const auto& list : after.lists)
+  {
+    auto old = before.lists.find(list.first);
+    if (old != before.lists.end() && old->second == list.second)
+      continue;
+    std::string entries = "{" + quote(LIST_LENGTH) + ":" + std::to_string(list.second.size());
+    for (std::size_t k = 0; k < list.second.size(); k++)
+      if (old == before.lists.end() || k >= old->second.size() || old->second[k] != list.second[k])
+        entries += ",\"" + std::to_string(k) + "\":" + list.second[k];
+    add(list.first, entries + "}");
+  }
+  return members;
+}
+
+// The delta event that takes a client from one snapshot to another
+static std::string delta(const Snapshot& before, const Snapshot& after)
+{
+  std::string data = diff(before.game, after.game);
+  std::string objects;
+  for (const auto& object : after.objects)
+  {
+    auto old = before.objects.find(object.first);
+    std::string changes = diff(old == before.objects.end() ? Fields() : old->second, object.second);
+    if (!changes.empty())
+      objects += (objects.empty() ? "" : ",") + quote(std::to_string(object.first)) + ":{" + changes + "}";
+  }
+  if (!objects.empty())
+    data += (data.empty() ? "" : ",") + std::string("\"gameObjects\":{") + objects + "}";
+  return "{\"event\":\"delta\",\"data\":{" + data + "}}";
+}
+
+// A player: a client, or the server itself playing random moves
+struct Seat {
+    std::unique_ptr<Client> client; // nullptr for the server's own player
+    std::string name;
+    std::string client_type;
+    double time_remaining; // Nanoseconds
+    bool made_move;
+    bool won;
+    bool lost;
+    std::string reason_won;
+    std::string reason_lost;
+    Timings timings;
+};
+
+// A piece as the clients see it; it keeps its id when captured
+struct BoardPiece {
+    PieceType type;
+    bool owner;
+    int tile; // Numbered as in MyMove::id()
+    bool moved;
+    bool captured;
+};
+
+// A move as the clients see it
+struct PlayedMove {
+    int piece; // Index into pieces
+    int captured; // Index into pieces, or -1
+    MyMove move;
+    std::string san;
+};
+
+// Standard algebraic notation of a legal move, before it is applied
+static std::string san(State& state, const MyMove& move)
+{
+  std::string text;
+  PieceType type = state.getPiece(move.file, move.rank)->type;
+  bool capture = (move.capture != NO_PIECE || move.move_type == "En Passant");
+  if (move.move_type == "Castle")
+    text = (move.file2 == 'g' ? "O-O" : "O-O-O");
+  else if (type == PAWN)
+  {
+    if (capture)
+      text = std::string(1, move.file) + "x";
+    text += std::string(1, move.file2) + std::to_string(move.rank2);
+    if (move.promotion != NO_PIECE)
+      text += std::string("=") + PIECE_SYMBOLS[0][move.promotion];
+  }
+  else
+  {
+    // Name the starting file, rank or both when another piece of the type could also move there
+    bool ambiguous = false, same_file = false, same_rank = false;
+    for (const MyMove& other : state.ACTIONS())
+    {
+      if (other.to() != move.to() || other.from() == move.from() || state.getPiece(other.file, other.rank)->type != type)
+        continue;
+      ambiguous = true;
+      same_file |= (other.file == move.file);
+      same_rank |= (other.rank == move.rank);
+    }
+    text = PIECE_SYMBOLS[0][type];
+    if (ambiguous && (!same_file || same_rank))
+      text += move.file;
+    if (ambiguous && same_file)
+      text += std::to_string(move.rank);
+    if (capture)
+      text += "x";
+    text += std::string(1, move.file2) + std::to_string(move.rank2);
+  }
+
+  State after = state.RESULT(move);
+  if (after.in_check())
+    text += (after.actions_exist() ? "+" : "#");
+  return text;
+}
+
+//////////////////////////////////////////////////////////////////////
+/// @class Session
+/// @brief One game between two seats, played on its own thread
+//////////////////////////////////////////////////////////////////////
+class Session {
+  private:
+    State state;
+    std::vector<BoardPiece> pieces;
+    std::vector<PlayedMove> moves;
+    int occupant[64]; // Index into pieces of each tile's piece, or -1
+    int current_turn;
+    Snapshot sent; // What the clients were last sent
+
+    // Ids of game objects: the seats, then the pieces, then the moves
+    int piece_id(int index) const { return 2 + index; }
+    int move_id(int index) const { return 2 + static_cast<int>(pieces.size()) + index; }
+
+    // The whole game as the clients should see it
+    Snapshot snapshot() const;
+
+    // Send every client what changed since the last delta
+    void broadcast();
+
+    // Send every client a message
+    void send_all(const std::string& message);
+
+    // Play a legal move for the player to move, keeping the pieces' ids
+    void play(const MyMove& move);
+
+    // Handle a run event from the player to move
+    // Returns the move played, or an error message starting with "!"
+    std::string run(int mover, const rapidjson::Value& data);
+
+    // End the game, the given seat winning; -1 for a draw
+    void finish(int winner, const std::string& reason_won, const std::string& reason_lost);
+
+  public:
+    const std::string name;
+    Seat seats[2]; // White, then black
+    int max_turns;
+    double increment; // Nanoseconds added to a clock after each turn
+    std::string result; // The score, e.g. "1-0", once over
+
+    Session(const std::string& name_, const std::string& fen, double time, double increment_, int max_turns_);
+
+    // Whether every seat has a client or is the server's
+    bool full() const;
+
+    // Play the game to its end; the seats must be full
+    void run();
+};
+
+Session::Session(const std::string& name_, const std::string& fen, double time, double increment_, int max_turns_)
+  : state(State::from_fen(fen)), current_turn(0), name(name_), max_turns(max_turns_), increment(increment_)
+{
+  for (Seat& seat : seats)
+  {
+    seat.time_remaining = time;
+    seat.made_move = seat.won = seat.lost = false;
+  }
+  for (int tile = 0; tile < 64; tile++)
+  {
+    occupant[tile] = -1;
+    const MyPiece* piece = state.getPiece('a' + tile % 8, tile / 8 + 1);
+    if (piece == nullptr)
+      continue;
+    occupant[tile] = static_cast<int>(pieces.size());
+    // A FEN only says which pieces have moved through castling rights; assume none have
+    pieces.push_back(BoardPiece{piece->type, piece->owner, tile, false, false});
+  }
+}
+
+bool Session::full() const
+{
+  return seats[0].name != "" && seats[1].name != "";
+}
+
+Snapshot Session::snapshot() const
+{
+  Snapshot shot;
+  bool mover = state.player_to_move();
+  Fields& game = shot.game;
+  game.values["currentPlayer"] = reference(mover);
+  game.values["currentTurn"] = std::to_string(current_turn);
+  game.values["fen"] = quote(state.to_fen());
+  game.values["maxTurns"] = std::to_string(max_turns);
+  game.values["session"] = quote(name);
+  game.values["turnsToDraw"] = std::to_string(std::max(0, 100 - state.halfmove_clock()));
+  game.lists["players"] = {reference(0), reference(1)};
+  std::vector<std::string>& game_moves = game.lists["moves"];
+  for (std::size_t m = 0; m < moves.size(); m++)
+    game_moves.push_back(reference(move_id(m)));
+  std::vector<std::string>& game_pieces = game.lists["pieces"];
+  for (std::size_t p = 0; p < pieces.size(); p++)
+    if (!pieces[p].captured)
+      game_pieces.push_back(reference(piece_id(p)));
+
+  for (int s = 0; s < 2; s++)
+  {
+    const Seat& seat = seats[s];
+    Fields& player = shot.objects[s];
+    player.values["gameObjectName"] = quote("Player");
+    player.values["id"] = quote(std::to_string(s));
+    player.values["clientType"] = quote(seat.client_type);
+    player.values["color"] = quote(s == 0 ? "White" : "Black");
+    player.values["inCheck"] = (s == mover && state.in_check() ? "true" : "false");
+    player.values["lost"] = (seat.lost ? "true" : "false");
+    player.values["madeMove"] = (seat.made_move ? "true" : "false");
+    player.values["name"] = quote(seat.name);
+    player.values["opponent"] = reference(!s);
+    player.values["rankDirection"] = (s == 0 ? "1" : "-1");
+    player.values["reasonLost"] = quote(seat.reason_lost);
+    player.values["reasonWon"] = quote(seat.reason_won);
+    player.values["timeRemaining"] = std::to_string(static_cast<long long>(seat.time_remaining));
+    player.values["won"] = (seat.won ? "true" : "false");
+    player.lists["logs"];
+    std::vector<std::string>& owned = player.lists["pieces"];
+    for (std::size_t p = 0; p < pieces.size(); p++)
+      if (!pieces[p].captured && pieces[p].owner == s)
+        owned.push_back(reference(piece_id(p)));
+  }
+
+  for (std::size_t p = 0; p < pieces.size(); p++)
+  {
+    const BoardPiece& piece = pieces[p];
+    Fields& object = shot.objects[piece_id(p)];
+    object.values["gameObjectName"] = quote("Piece");
+    object.values["id"] = quote(std::to_string(piece_id(p)));
+    object.values["captured"] = (piece.captured ? "true" : "false");
+    object.values["file"] = quote(std::string(1, 'a' + piece.tile % 8));
+    object.values["hasMoved"] = (piece.moved ? "true" : "false");
+    object.values["owner"] = reference(piece.owner);
+    object.values["rank"] = std::to_string(piece.tile / 8 + 1);
+    object.values["type"] = quote(PIECE_NAMES[piece.type]);
+    object.lists["logs"];
+  }
+
+  for (std::size_t m = 0; m < moves.size(); m++)
+  {
+    const PlayedMove& played = moves[m];
+    Fields& object = shot.objects[move_id(m)];
+    object.values["gameObjectName"] = quote("Move");
+    object.values["id"] = quote(std::to_string(move_id(m)));
+    object.values["captured"] = (played.captured < 0 ? "null" : reference(piece_id(played.captured)));
+    object.values["fromFile"] = quote(std::string(1, played.move.file));
+    object.values["fromRank"] = std::to_string(played.move.rank);
+    object.values["piece"] = reference(piece_id(played.piece));
+    object.values["promotion"] = quote(PIECE_NAMES[played.move.promotion]);
+    object.values["san"] = quote(played.san);
+    object.values["toFile"] = quote(std::string(1, played.move.file2));
+    object.values["toRank"] = std::to_string(played.move.rank2);
+    object.lists["logs"];
+  }
+  return shot;
+}
+
+void Session::send_all(const std::string& message)
+{
+  for (Seat& seat : seats)
+    if (seat.client)
+      seat.client->send(message);
+}
+
+void Session::broadcast()
+{
+  Snapshot now = snapshot();
+  std::string message = delta(sent, now);
+  sent = now;
+  send_all(message);
+}
+
+void Session::play(const MyMove& move)
+{
+  PlayedMove played{occupant[move.from()], occupant[move.to()], move, san(state, move)};
+  if (move.move_type == "En Passant")
+    played.captured = occupant[move.to() + (move.rank2 > move.rank ? -8 : 8)];
+  if (played.captured >= 0)
+  {
+    pieces[played.captured].captured = true;
+    occupant[pieces[played.captured].tile] = -1;
+  }
+
+  // The rook castles from its corner to beside the king's target
+  if (move.move_type == "Castle")
+  {
+    int rank = 8 * (move.rank - 1);
+    int corner = rank + (move.file2 == 'g' ? 7 : 0);
+    int beside = rank + (move.file2 == 'g' ? 5 : 3);
+    BoardPiece& rook = pieces[occupant[corner]];
+    occupant[beside] = occupant[corner];
+    occupant[corner] = -1;
+    rook.tile = beside;
+    rook.moved = true;
+  }
+
+  BoardPiece& piece = pieces[played.piece];
+  occupant[move.from()] = -1;
+  occupant[move.to()] = played.piece;
+  piece.tile = move.to();
+  piece.moved = true;
+  if (move.promotion != NO_PIECE)
+    piece.type = move.promotion;
+  moves.push_back(played);
+
+  // The moved state owns what the move displaced
+  for (auto displaced : state.APPLY(move))
+    delete displaced.second;
+}
+
+std::string Session::run(int mover, const rapidjson::Value& data)
+{
+  if (get_string(data, "functionName") != "move")
+    return "!Unknown function " + get_string(data, "functionName") + ".";
+  if (seats[mover].made_move)
+    return "!You already moved this turn.";
+
+  auto caller = data.FindMember("caller");
+  auto args = data.FindMember("args");
+  if (caller == data.MemberEnd() || args == data.MemberEnd() || !args->value.IsObject())
+    return "!Malformed run event.";
+  int id = std::atoi(get_string(caller->value, "id").c_str());
+  if (id < piece_id(0) || id >= piece_id(pieces.size()))
+    return "!The caller is not a piece.";
+  const BoardPiece& piece = pieces[id - piece_id(0)];
+  if (piece.captured || piece.owner != mover)
+    return "!That piece is not yours to move.";
+
+  std::string file = get_string(args->value, "file");
+  auto rank = args->value.FindMember("rank");
+  if (file.size() != 1 || rank == args->value.MemberEnd() || !rank->value.IsInt())
+    return "!Malformed move arguments.";
+  int to = (file[0] - 'a') + 8 * (rank->value.GetInt() - 1);
+
+  // A pawn reaching the last rank becomes a queen unless told otherwise
+  PieceType promotion = QUEEN;
+  std::string promotion_type = get_string(args->value, "promotionType");
+  for (int type = KNIGHT; type <= QUEEN; type++)
+    if (promotion_type == PIECE_NAMES[type])
+      promotion = static_cast<PieceType>(type);
+
+  for (const MyMove& move : state.ACTIONS())
+  {
+    if (move.from() == piece.tile && move.to() == to && (move.promotion == NO_PIECE || move.promotion == promotion))
+    {
+      play(move);
+      return move.uci();
+    }
+  }
+  return "!Illegal move for the " + std::string(PIECE_NAMES[piece.type]) + " on "
+         + static_cast<char>('a' + piece.tile % 8) + std::to_string(piece.tile / 8 + 1) + ".";
+}
+
+void Session::finish(int winner, const std::string& reason_won, const std::string& reason_lost)
+{
+  for (int s = 0; s < 2; s++)
+  {
+    // A draw is a loss for both, with the reason saying why
+    seats[s].won = (s == winner);
+    seats[s].lost = (s != winner);
+    seats[s].reason_won = (s == winner ? reason_won : "");
+    seats[s].reason_lost = (s != winner ? (winner < 0 ? "Draw - " + reason_lost : reason_lost) : "");
+  }
+  result = (winner < 0 ? "1/2-1/2" : winner == 0 ? "1-0" : "0-1");
+  broadcast();
+  send_all("{\"event\":\"over\",\"data\":{\"message\":" + quote("Game over in session " + name + ": " + result + " ("
+           + (winner < 0 ? reason_lost : reason_won) + ")") + "}}");
+}
+
+void Session::run()
+{
+  broadcast();
+  for (int s = 0; s < 2; s++)
+    if (seats[s].client)
+      seats[s].client->send("{\"event\":\"start\",\"data\":{\"playerID\":\"" + std::to_string(s) + "\"}}");
+
+  for (int order = 0; ; order++)
+  {
+    int mover = state.player_to_move();
+    Seat& seat = seats[mover];
+    seat.made_move = false;
+
+    if (!seat.client)
+    {
+      // The server's own player moves at random without using its clock
+      std::vector<MyMove> legal = state.ACTIONS();
+      play(legal[rand() % legal.size()]);
+      seat.made_move = true;
+      broadcast();
+    }
+    else
+    {
+      seat.client->send("{\"event\":\"order\",\"data\":{\"name\":\"runTurn\",\"index\":" + std::to_string(order) + ",\"args\":[]}}");
+      Clock::time_point ordered = Clock::now();
+      Clock::time_point deadline = ordered + std::chrono::nanoseconds(static_cast<long long>(seat.time_remaining));
+      Clock::time_point acknowledged = ordered;
+      bool finished = false;
+      std::string message;
+      while (!finished && seat.client->receive(message, deadline))
+      {
+        rapidjson::Document event;
+        event.Parse(message.c_str());
+        if (event.HasParseError() || !event.IsObject())
+          continue;
+        auto sent_time = event.FindMember("sentTime");
+        if (sent_time != event.MemberEnd() && sent_time->value.IsNumber())
+        {
+          using namespace std::chrono;
+          double now = duration_cast<microseconds>(system_clock::now().time_since_epoch()).count() / 1e3;
+          seat.timings.transit.push_back(now - sent_time->value.GetDouble());
+        }
+
+        std::string type = get_string(event, "event");
+        auto data = event.FindMember("data");
+        if (type == "run" && data != event.MemberEnd())
+        {
+          seat.timings.think.push_back(ms_since(ordered));
+          std::string played = run(mover, data->value);
+          if (played[0] == '!')
+          {
+            seat.client->send("{\"event\":\"invalid\",\"data\":{\"message\":" + quote(played.substr(1)) + "}}");
+            seat.client->send("{\"event\":\"ran\",\"data\":null}");
+          }
+          else
+          {
+            seat.made_move = true;
+            broadcast();
+            seat.client->send("{\"event\":\"ran\",\"data\":" + reference(move_id(moves.size() - 1)) + "}");
+          }
+          acknowledged = Clock::now();
+        }
+        else if (type == "finished")
+          finished = true;
+      }
+
+      double used = ms_since(ordered);
+      seat.time_remaining -= used * 1e6;
+      if (!finished || seat.time_remaining < 0)
+      {
+        seat.time_remaining = 0;
+        finish(!mover, "Opponent ran out of time.", "Ran out of time.");
+        return;
+      }
+      seat.timings.turn.push_back(used);
+      if (seat.made_move)
+        seat.timings.reply.push_back(ms_since(acknowledged));
+      else
+      {
+        finish(!mover, "Opponent did not make a move.", "Did not make a move.");
+        return;
+      }
+      seat.time_remaining += increment;
+    }
+
+    current_turn++;
+    seat.made_move = false;
+    if (!state.actions_exist())
+    {
+      if (state.in_check())
+        finish(mover, "Checkmate!", "Checkmated.");
+      else
+        finish(-1, "", "Stalemate.");
+      return;
+    }
+    if (state.stalemate())
+    {
+      if (state.halfmove_clock() >= 100)
+        finish(-1, "", "50-move rule.");
+      else if (state.repetitions() >= 2)
+        finish(-1, "", "Threefold repetition.");
+      else
+        finish(-1, "", "Insufficient material.");
+      return;
+    }
+    if (current_turn >= max_turns)
+    {
+      finish(-1, "", "Turn limit reached.");
+      return;
+    }
+    broadcast();
+  }
+}
+
+//////////////////////////////////////////////////////////////////////
+/// @class Lobby
+/// @brief Seats clients in sessions and starts each game once it is full
+//////////////////////////////////////////////////////////////////////
+class Lobby {
+  private:
+    std::mutex lock;
+    std::map<std::string, std::shared_ptr<Session>> open; // Sessions waiting for players, by name
+    int next_session;
+    std::vector<std::thread> greeters; // Threads running greet(); only the accepting thread touches this
+
+    // Take a new connection through alias and play, then seat it
+    void greet(std::shared_ptr<netLink::Socket> socket);
+
+  public:
+    // Game settings for new sessions
+    std::string fen;
+    double time;
+    double increment;
+    int max_turns;
+    bool house; // Whether the server takes black when only one client joins
+
+    bool print; // Whether to print the traffic
+    int games; // Games to play before exiting
+
+    std::vector<std::shared_ptr<Session>> started;
+    std::vector<std::thread> threads;
+
+    Lobby() : next_session(1) {}
+
+    // Greet a new connection on its own thread, so a slow client does not hold up the rest
+    void welcome(std::shared_ptr<netLink::Socket> socket);
+
+    // Whether every game has started
+    bool all_started();
+
+    // Wait for every greeting and started game to end, then print every client's timings together
+    //      Connections still being greeted hold the lobby, so it must outlive this call
+    void finish();
+};
+
+bool Lobby::all_started()
+{
+  std::lock_guard<std::mutex> guard(lock);
+  return static_cast<int>(started.size()) >= games;
+}
+
+void Lobby::welcome(std::shared_ptr<netLink::Socket> socket)
+{
+  greeters.push_back(std::thread(&Lobby::greet, this, socket));
+}
+
+void Lobby::finish()
+{
+  // Once these end, nothing can add to threads or started
+  for (std::thread& greeter : greeters)
+    greeter.join();
+  for (std::thread& thread : threads)
+    thread.join();
+  if (started.size() < 2)
+    return;
+
+  std::map<std::string, Timings> totals;
+  for (const auto& session : started)
+    for (const Seat& seat : session->seats)
+      if (seat.client)
+        totals[seat.name].add(seat.timings);
+  std::vector<std::pair<std::string, Timings>> rows(totals.begin(), totals.end());
+  std::cout << "all " << started.size() << " sessions:" << std::endl;
+  print_timings(rows);
+}
+
+void Lobby::greet(std::shared_ptr<netLink::Socket> socket)
+{
+  std::unique_ptr<Client> client(new Client(socket, print));
+  Clock::time_point deadline = Clock::now() + std::chrono::seconds(HANDSHAKE_SECONDS);
+  std::string message;
+  rapidjson::Document event;
+  try
+  {
+    // The client's alias lookup connects, asks and hangs up, so a connection may end here
+    while (client->receive(message, deadline))
+    {
+      event.Parse(message.c_str());
+      if (event.HasParseError() || !event.IsObject())
+        return;
+      std::string type = get_string(event, "event");
+      if (type == "alias")
+      {
+        std::string alias = get_string(event, "data");
+        std::transform(alias.begin(), alias.end(), alias.begin(), ::tolower);
+        if (alias != "chess")
+        {
+          client->send("{\"event\":\"fatal\",\"data\":{\"message\":" + quote("This server only plays Chess, not " + alias + ".") + "}}");
+          return;
+        }
+        client->send("{\"event\":\"named\",\"data\":\"Chess\"}");
+      }
+      else if (type == "play")
+        break;
+    }
+    if (get_string(event, "event") != "play")
+      return;
+
+    const rapidjson::Value& data = event["data"];
+    std::string requested = get_string(data, "requestedSession", "*");
+    auto index = data.FindMember("playerIndex");
+    int wanted = (index != data.MemberEnd() && index->value.IsInt() ? index->value.GetInt() : -1);
+
+    std::lock_guard<std::mutex> guard(lock);
+    if (static_cast<int>(started.size()) >= games)
+    {
+      client->send("{\"event\":\"fatal\",\"data\":{\"message\":\"The server is not taking more games.\"}}");
+      return;
+    }
+    // "*" joins whichever session is waiting, or starts one
+    if (requested == "*")
+      requested = (open.empty() ? std::to_string(next_session++) : open.begin()->first);
+    std::shared_ptr<Session>& session = open[requested];
+    if (!session)
+      session.reset(new Session(requested, fen, time, increment, max_turns));
+
+    int s = (wanted == 0 || wanted == 1) && session->seats[wanted].name == "" ? wanted : (session->seats[0].name == "" ? 0 : 1);
+    Seat& seat = session->seats[s];
+    seat.name = get_string(data, "playerName", "Player " + std::to_string(s));
+    seat.client_type = get_string(data, "clientType");
+    client->label = seat.name + " (session " + requested + ")";
+    client->send("{\"event\":\"lobbied\",\"data\":{\"gameName\":\"Chess\",\"gameSession\":" + quote(requested)
+                 + ",\"constants\":{\"DELTA_LIST_LENGTH\":" + quote(LIST_LENGTH) + ",\"DELTA_REMOVED\":" + quote(REMOVED) + "}}}");
+    seat.client = std::move(client);
+
+    if (house && session->seats[1].name == "")
+    {
+      session->seats[1].name = "Server";
+      session->seats[1].client_type = "Server";
+    }
+    if (session->full())
+    {
+      std::shared_ptr<Session> ready = session;
+      open.erase(requested);
+      started.push_back(ready);
+      threads.push_back(std::thread([ready]()
+      {
+        Clock::time_point start = Clock::now();
+        try
+        {
+          ready->run();
+        }
+        catch (netLink::Exception& e)
+        {
+          ready->result = "aborted";
+        }
+        std::lock_guard<std::mutex> guard(print_lock);
+        std::cout << "session " << ready->name << ": " << ready->seats[0].name << " vs " << ready->seats[1].name
+                  << " " << ready->result << " (" << (ready->result == "1-0" ? ready->seats[0].reason_won
+                  : ready->result == "0-1" ? ready->seats[1].reason_won : ready->seats[0].reason_lost)
+                  << ") in " << ms_since(start) / 1e3 << "s" << std::endl;
+        std::vector<std::pair<std::string, Timings>> rows;
+        for (const Seat& seat : ready->seats)
+          if (seat.client)
+            rows.push_back(std::make_pair(seat.name, seat.timings));
+        print_timings(rows);
+      }));
+    }
+  }
+  catch (netLink::Exception& e)
+  {
+    // The connection failed before it was seated; nothing else depends on it
+  }
+}
+
+int main(int argc, const char* argv[])
+{
+  try
+  {
+    TCLAP::CmdLine cmd("Stands in for the game server so cpp-client can be run and timed locally.");
+    TCLAP::ValueArg<int> port_arg("p", "port", "The port to listen on", false, 3000, "port number");
+    TCLAP::ValueArg<int> games_arg("g", "games", "Games to play before exiting; sessions run at the same time", false, 1, "int");
+    TCLAP::ValueArg<std::string> fen_arg("f", "fen", "The starting position", false, START_FEN, "FEN");
+    TCLAP::ValueArg<double> time_arg("t", "time", "Seconds on each clock", false, 900, "seconds");
+    TCLAP::ValueArg<double> increment_arg("i", "increment", "Seconds added to a clock after each turn", false, 0, "seconds");
+    TCLAP::ValueArg<int> turns_arg("m", "max-turns", "Turns after which a game is drawn", false, 6000, "int");
+    TCLAP::SwitchArg house_arg("", "house", "Play black with random moves, so one client makes a game", false);
+    TCLAP::SwitchArg print_arg("", "printIO", "Print the traffic with every client", false);
+    cmd.add(port_arg);
+    cmd.add(games_arg);
+    cmd.add(fen_arg);
+    cmd.add(time_arg);
+    cmd.add(increment_arg);
+    cmd.add(turns_arg);
+    cmd.add(house_arg);
+    cmd.add(print_arg);
+    cmd.parse(argc, argv);
+
+    State::from_fen(fen_arg.getValue()); // Reject a bad position before anyone connects
+
+    #ifdef WIN32
+    netLink::init();
+    #endif
+
+    Lobby lobby;
+    lobby.fen = fen_arg.getValue();
+    lobby.time = time_arg.getValue() * 1e9;
+    lobby.increment = increment_arg.getValue() * 1e9;
+    lobby.max_turns = turns_arg.getValue();
+    lobby.house = house_arg.getValue();
+    lobby.print = print_arg.getValue();
+    lobby.games = games_arg.getValue();
+
+    netLink::Socket server;
+    server.initAsTcpServer("*", port_arg.getValue());
+    std::cout << "Listening on port " << port_arg.getValue() << " for " << lobby.games << " game(s)" << std::endl;
+
+    while (!lobby.all_started())
+    {
+      std::shared_ptr<netLink::Socket> socket = server.accept();
+      if (socket)
+      {
+        socket->setBlockingMode(true);
+        lobby.welcome(socket);
+      }
+      else
+        std::this_thread::sleep_for(std::chrono::milliseconds(1));
+    }
+    lobby.finish();
+  }
+  catch(TCLAP::ArgException& e)
+  {
+    std::cerr << "error: " << e.error() << " for arg " << e.argId() << std::endl;
+    return 1;
+  }
+  catch(std::invalid_argument& e)
+  {
+    std::cerr << "error: " << e.what() << std::endl;
+    return 1;
+  }
+  catch(netLink::Exception& e)
+  {
+    std::cerr << "error: could not listen (netLink error " << e.code << ")" << std::endl;
+    return 1;
+  }
+  return 0;
+}
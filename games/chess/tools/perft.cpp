@@ -0,0 +1,204 @@
+//////////////////////////////////////////////////////////////////////
+/// @file perft.cpp
+/// @author Shawn McCormick CS5400
+/// @brief Move generator correctness and throughput harness
+///
+/// Counts the leaves of the legal move tree from a FEN to a fixed depth.
+/// The counts are compared against the published ones in the suite, so
+/// every change to State::ACTIONS, APPLY or UNDO should be run through
+/// `perft --suite` before it is played on the server.
+//////////////////////////////////////////////////////////////////////
+
+#include "tclap/CmdLine.h"
+#include "../custom_board.hpp"
+
+#include <chrono>
+#include <iostream>
+#include <stdexcept>
+
+using namespace cpp_client::chess;
+
+const char START_FEN[] = "rnbqkbnr/pppppppp/8/8/8/8/PPPPPPPP/RNBQKBNR w KQkq - 0 1";
+
+// A position with its known leaf count at one depth
+struct PerftCase {
+    const char* name;
+    const char* fen;
+    int depth;
+    unsigned long long nodes;
+};
+
+// Standard positions from the Chess Programming Wiki and edge cases collected
+// by Martin Sedlak; ordered cheapest first within each group
+const PerftCase SUITE[] = {
+    {"start", START_FEN, 1, 20ULL},
+    {"start", START_FEN, 2, 400ULL},
+    {"start", START_FEN, 3, 8902ULL},
+    {"start", START_FEN, 4, 197281ULL},
+    {"kiwipete", "r3k2r/p1ppqpb1/bn2pnp1/3PN3/1p2P3/2N2Q1p/PPPBBPPP/R3K2R w KQkq - 0 1", 1, 48ULL},
+    {"kiwipete", "r3k2r/p1ppqpb1/bn2pnp1/3PN3/1p2P3/2N2Q1p/PPPBBPPP/R3K2R w KQkq - 0 1", 2, 2039ULL},
+    {"kiwipete", "r3k2r/p1ppqpb1/bn2pnp1/3PN3/1p2P3/2N2Q1p/PPPBBPPP/R3K2R w KQkq - 0 1", 3, 97862ULL},
+    {"endgame", "8/2p5/3p4/KP5r/1R3p1k/8/4P1P1/8 w - - 0 1", 1, 14ULL},
+    {"endgame", "8/2p5/3p4/KP5r/1R3p1k/8/4P1P1/8 w - - 0 1", 2, 191ULL},
+    {"endgame", "8/2p5/3p4/KP5r/1R3p1k/8/4P1P1/8 w - - 0 1", 3, 2812ULL},
+    {"endgame", "8/2p5/3p4/KP5r/1R3p1k/8/4P1P1/8 w - - 0 1", 4, 43238ULL},
+    {"endgame", "8/2p5/3p4/KP5r/1R3p1k/8/4P1P1/8 w - - 0 1", 5, 674624ULL},
+    {"promotions", "r3k2r/Pppp1ppp/1b3nbN/nP6/BBP1P3/q4N2/Pp1P2PP/R2Q1RK1 w kq - 0 1", 1, 6ULL},
+    {"promotions", "r3k2r/Pppp1ppp/1b3nbN/nP6/BBP1P3/q4N2/Pp1P2PP/R2Q1RK1 w kq - 0 1", 2, 264ULL},
+    {"promotions", "r3k2r/Pppp1ppp/1b3nbN/nP6/BBP1P3/q4N2/Pp1P2PP/R2Q1RK1 w kq - 0 1", 3, 9467ULL},
+    {"promotions", "r3k2r/Pppp1ppp/1b3nbN/nP6/BBP1P3/q4N2/Pp1P2PP/R2Q1RK1 w kq - 0 1", 4, 422333ULL},
+    {"talkchess", "rnbq1k1r/pp1Pbppp/2p5/8/2B5/8/PPP1NnPP/RNBQK2R w KQ - 1 8", 1, 44ULL},
+    {"talkchess", "rnbq1k1r/pp1Pbppp/2p5/8/2B5/8/PPP1NnPP/RNBQK2R w KQ - 1 8", 2, 1486ULL},
+    {"talkchess", "rnbq1k1r/pp1Pbppp/2p5/8/2B5/8/PPP1NnPP/RNBQK2R w KQ - 1 8", 3, 62379ULL},
+    {"middlegame", "r4rk1/1pp1qppp/p1np1n2/2b1p1B1/2B1P1b1/P1NP1N2/1PP1QPPP/R4RK1 w - - 0 10", 1, 46ULL},
+    {"middlegame", "r4rk1/1pp1qppp/p1np1n2/2b1p1B1/2B1P1b1/P1NP1N2/1PP1QPPP/R4RK1 w - - 0 10", 2, 2079ULL},
+    {"middlegame", "r4rk1/1pp1qppp/p1np1n2/2b1p1B1/2B1P1b1/P1NP1N2/1PP1QPPP/R4RK1 w - - 0 10", 3, 89890ULL},
+
+    {"illegal ep move #1", "3k4/3p4/8/K1P4r/8/8/8/8 b - - 0 1", 6, 1134888ULL},
+    {"illegal ep move #2", "8/8/4k3/8/2p5/8/B2P2K1/8 w - - 0 1", 6, 1015133ULL},
+    {"ep capture checks opponent", "8/8/1k6/2b5/2pP4/8/5K2/8 b - d3 0 1", 6, 1440467ULL},
+    {"short castling gives check", "5k2/8/8/8/8/8/8/4K2R w K - 0 1", 6, 661072ULL},
+    {"long castling gives check", "3k4/8/8/8/8/8/8/R3K3 w Q - 0 1", 6, 803711ULL},
+    {"castle rights", "r3k2r/1b4bq/8/8/8/8/7B/R3K2R w KQkq - 0 1", 4, 1274206ULL},
+    {"castling prevented", "r3k2r/8/3Q4/8/8/5q2/8/R3K2R b KQkq - 0 1", 4, 1720476ULL},
+    {"promote out of check", "2K2r2/4P3/8/8/8/8/8/3k4 w - - 0 1", 6, 3821001ULL},
+    {"discovered check", "8/8/1P2K3/8/2n5/1q6/8/5k2 b - - 0 1", 5, 1004658ULL},
+    {"promote to give check", "4k3/1P6/8/8/8/8/K7/8 w - - 0 1", 6, 217342ULL},
+    {"underpromote to check", "8/P1k5/K7/8/8/8/8/8 w - - 0 1", 6, 92683ULL},
+    {"self stalemate", "K1k5/8/P7/8/8/8/8/8 w - - 0 1", 6, 2217ULL},
+    {"stalemate & checkmate #1", "8/k1P5/8/1K6/8/8/8/8 w - - 0 1", 7, 567584ULL},
+    {"stalemate & checkmate #2", "8/8/2k5/5q2/5n2/8/5K2/8 b - - 0 1", 4, 23527ULL},
+};
+
+// Count the leaves of the legal move tree
+// Parameters:
+//      State& state: The position to count from; restored before returning
+//      int depth: The number of plies to count to
+// Returns the number of positions reached at depth
+unsigned long long perft(State& state, int depth)
+{
+  if (depth == 0)
+    return 1;
+
+  std::vector<MyMove> actions = state.ACTIONS();
+  // Bulk count: the last ply's moves need not be made
+  if (depth == 1)
+    return actions.size();
+
+  unsigned long long nodes = 0;
+  for (const MyMove& action : actions)
+  {
+    auto preserved = state.APPLY(action);
+    nodes += perft(state, depth - 1);
+    state.UNDO(preserved);
+  }
+  return nodes;
+}
+
+// Seconds since start
+double seconds_since(std::chrono::steady_clock::time_point start)
+{
+  return std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+}
+
+// Nodes per second, guarding against a zero elapsed time
+unsigned long long nps(unsigned long long nodes, double seconds)
+{
+  return (seconds > 0 ? static_cast<unsigned long long>(nodes / seconds) : 0);
+}
+
+// Perft from one position, printing the count under each root move if divide is set
+unsigned long long run(const std::string& fen, int depth, bool divide)
+{
+  State state = State::from_fen(fen);
+  auto start = std::chrono::steady_clock::now();
+  unsigned long long nodes = 0;
+
+  if (divide && depth > 0)
+  {
+    for (const MyMove& action : state.ACTIONS())
+    {
+      auto preserved = state.APPLY(action);
+      unsigned long long count = perft(state, depth - 1);
+      state.UNDO(preserved);
+      std::cout << action.uci() << ": " << count << std::endl;
+      nodes += count;
+    }
+    std::cout << std::endl;
+  }
+  else
+    nodes = perft(state, depth);
+
+  double elapsed = seconds_since(start);
+  std::cout << "Nodes: " << nodes << std::endl
+            << "Time:  " << elapsed << " s" << std::endl
+            << "NPS:   " << nps(nodes, elapsed) << std::endl;
+  return nodes;
+}
+
+// Run every suite case no deeper than max_depth
+// Returns the number of cases whose count was wrong
+int run_suite(int max_depth)
+{
+  int failures = 0;
+  unsigned long long total = 0;
+  auto start = std::chrono::steady_clock::now();
+
+  for (const PerftCase& test : SUITE)
+  {
+    if (test.depth > max_depth)
+      continue;
+    State state = State::from_fen(test.fen);
+    auto case_start = std::chrono::steady_clock::now();
+    unsigned long long nodes = perft(state, test.depth);
+    double elapsed = seconds_since(case_start);
+    total += nodes;
+
+    bool ok = (nodes == test.nodes);
+    if (!ok)
+      failures++;
+    std::cout << (ok ? "PASS " : "FAIL ") << test.name << " depth " << test.depth
+              << ": " << nodes;
+    if (!ok)
+      std::cout << " (expected " << test.nodes << ")";
+    std::cout << "  " << nps(nodes, elapsed) << " nps" << std::endl;
+  }
+
+  double elapsed = seconds_since(start);
+  std::cout << std::endl << (failures == 0 ? "All passed" : std::to_string(failures) + " failed")
+            << ", " << total << " nodes in " << elapsed << " s, " << nps(total, elapsed) << " nps" << std::endl;
+  return failures;
+}
+
+int main(int argc, const char* argv[])
+{
+  try
+  {
+    TCLAP::CmdLine cmd("Counts legal move tree leaves to validate and benchmark the move generator.");
+    TCLAP::ValueArg<std::string> fen_arg("f", "fen", "The position to count from", false, START_FEN, "FEN");
+    TCLAP::ValueArg<int> depth_arg("d", "depth", "Plies to count to; with --suite, the deepest case to run", false, 4, "int");
+    TCLAP::SwitchArg divide_arg("", "divide", "Print the count under each root move", false);
+    TCLAP::SwitchArg suite_arg("s", "suite", "Check the bundled positions against their known counts", false);
+    cmd.add(fen_arg);
+    cmd.add(depth_arg);
+    cmd.add(divide_arg);
+    cmd.add(suite_arg);
+    cmd.parse(argc, argv);
+
+    if (suite_arg.getValue())
+      return (run_suite(depth_arg.getValue()) == 0 ? 0 : 1);
+
+    run(fen_arg.getValue(), depth_arg.getValue(), divide_arg.getValue());
+  }
+  catch(TCLAP::ArgException& e)
+  {
+    std::cerr << "error: " << e.error() << " for arg " << e.argId() << std::endl;
+    return 1;
+  }
+  catch(std::invalid_argument& e)
+  {
+    std::cerr << "error: " << e.what() << std::endl;
+    return 1;
+  }
+  return 0;
+}
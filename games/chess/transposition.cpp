@@ -0,0 +1,111 @@
+////////////////////////////////////////////////////////////////////// 
+/// @file transposition.cpp 
+/// @author Shawn McCormick CS5400
+/// @brief Implementation of the transposition table
+////////////////////////////////////////////////////////////////////// 
+
+#include "transposition.hpp"
+
+#include <algorithm>
+#include <cstring>
+
+namespace cpp_client
+{
+
+namespace chess
+{
+
+// Layout of a packed entry:
+//      bits  0-31  value
+//      bits 32-47  move
+//      bits 48-55  depth
+//      bits 56-57  bound
+//      bits 58-63  generation
+const int GENERATIONS = 64;
+
+U64 pack(const TTEntry& entry)
+{
+  uint32_t bits;
+  std::memcpy(&bits, &entry.value, sizeof(bits));
+  return bits | (U64)entry.move << 32 | (U64)std::min(std::max(entry.depth, 0), 255) << 48
+    | (U64)entry.bound << 56 | (U64)entry.generation << 58;
+}
+
+TTEntry unpack(U64 data)
+{
+  TTEntry entry;
+  uint32_t bits = static_cast<uint32_t>(data);
+  std::memcpy(&entry.value, &bits, sizeof(entry.value));
+  entry.move = static_cast<uint16_t>(data >> 32);
+  entry.depth = static_cast<int>((data >> 48) & 0xFF);
+  entry.bound = static_cast<Bound>((data >> 56) & 0x3);
+  entry.generation = static_cast<int>(data >> 58);
+  return entry;
+}
+
+TranspositionTable::TranspositionTable(int size_log2) : table(new Slot[1ULL << size_log2]), mask((1ULL << size_log2) - 1), generation(0)
+{
+  clear();
+}
+
+bool TranspositionTable::probe(U64 key, TTEntry& entry)
+{
+  probe_count.fetch_add(1, std::memory_order_relaxed);
+
+  Slot& slot = table[key & mask];
+  U64 data = slot.data.load(std::memory_order_relaxed);
+  U64 check = slot.check.load(std::memory_order_relaxed);
+  if ((check ^ data) != key)
+    return false;
+
+  entry = unpack(data);
+  hit_count.fetch_add(1, std::memory_order_relaxed);
+  return true;
+}
+
+void TranspositionTable::store(U64 key, int depth, float value, Bound bound, uint16_t move)
+{
+  Slot& slot = table[key & mask];
+
+  // Keep deeper results from this search
+  U64 old_data = slot.data.load(std::memory_order_relaxed);
+  TTEntry old = unpack(old_data);
+  if (old.bound != BOUND_NONE && old.generation == generation && old.depth > depth)
+    return;
+
+  // Don't lose the best move when re-storing a position without one
+  if (move == 0 && (slot.check.load(std::memory_order_relaxed) ^ old_data) == key)
+    move = old.move;
+
+  TTEntry entry;
+  entry.value = value;
+  entry.move = move;
+  entry.depth = depth;
+  entry.bound = bound;
+  entry.generation = generation;
+
+  U64 data = pack(entry);
+  slot.data.store(data, std::memory_order_relaxed);
+  slot.check.store(key ^ data, std::memory_order_relaxed);
+}
+
+void TranspositionTable::new_search()
+{
+  generation = (generation + 1) % GENERATIONS;
+}
+
+void TranspositionTable::clear()
+{
+  for (U64 i = 0; i <= mask; i++)
+  {
+    // An empty slot has BOUND_NONE and only validates for a key of all ones
+    table[i].data.store(0, std::memory_order_relaxed);
+    table[i].check.store(~0ULL, std::memory_order_relaxed);
+  }
+  probe_count.store(0, std::memory_order_relaxed);
+  hit_count.store(0, std::memory_order_relaxed);
+}
+
+}
+
+}
@@ -0,0 +1,92 @@
+////////////////////////////////////////////////////////////////////// 
+/// @file transposition.hpp 
+/// @author Shawn McCormick CS5400
+/// @brief Transposition table of searched positions
+////////////////////////////////////////////////////////////////////// 
+
+#ifndef TRANSPOSITION_HPP
+#define TRANSPOSITION_HPP
+
+#include <atomic>
+#include <cstdint>
+#include <memory>
+
+typedef unsigned long long U64;
+
+namespace cpp_client
+{
+
+namespace chess
+{
+
+// How a stored value relates to the position's true value
+enum Bound { BOUND_NONE, BOUND_UPPER, BOUND_LOWER, BOUND_EXACT };
+
+////////////////////////////////////////////////////////////////////// 
+/// @class TTEntry 
+/// @brief The result of searching a position
+////////////////////////////////////////////////////////////////////// 
+struct TTEntry {
+    float value; // The value found
+    uint16_t move; // MyMove::id() of the best move, or 0 if none
+    int depth; // The depth searched to
+    Bound bound; // Whether value is exact or a bound
+    int generation; // The search that stored this entry
+};
+
+////////////////////////////////////////////////////////////////////// 
+/// @class TranspositionTable 
+/// @brief Direct-mapped table of TTEntry keyed by Zobrist hash
+///
+/// Slots use the same key-xor-data check as EvalCache, so the table can
+/// be shared by the main and ponder searches without locking. Entries
+/// carry the generation of the search that wrote them; stale generations
+/// are always replaced, and within a generation deeper results are kept.
+////////////////////////////////////////////////////////////////////// 
+class TranspositionTable {
+  private:
+    struct Slot {
+        std::atomic<U64> check; // key ^ data
+        std::atomic<U64> data; // The packed TTEntry
+    };
+
+    std::unique_ptr<Slot[]> table; // The table slots
+    U64 mask; // Number of slots - 1; used to map keys to slots
+    int generation; // Generation stamped on new entries
+
+    std::atomic<U64> probe_count; // Number of lookups performed
+    std::atomic<U64> hit_count; // Number of lookups that found their key
+
+  public:
+    // Construct a table with 2^size_log2 slots
+    explicit TranspositionTable(int size_log2 = 20);
+
+    TranspositionTable(const TranspositionTable&) = delete;
+    TranspositionTable& operator=(const TranspositionTable&) = delete;
+
+    // Look up a key
+    // Parameters:
+    //      U64 key: The Zobrist hash of the position
+    //      TTEntry& entry: Set to the stored entry on a hit
+    // Returns true if the key was found, else false
+    bool probe(U64 key, TTEntry& entry);
+
+    // Store the result of a search, subject to the replacement policy
+    void store(U64 key, int depth, float value, Bound bound, uint16_t move);
+
+    // Start a new generation; entries from earlier generations become replaceable
+    void new_search();
+
+    // Empty every slot and reset the counters
+    void clear();
+
+    // Hit-rate counters
+    U64 probes() const { return probe_count.load(std::memory_order_relaxed); }
+    U64 hits() const { return hit_count.load(std::memory_order_relaxed); }
+};
+
+}
+
+}
+
+#endif
@@ -27,6 +27,7 @@
 #include <arpa/inet.h>
 #include <sys/fcntl.h>
 #include <netdb.h>
+#include <netinet/tcp.h>
 #include <sys/ioctl.h>
 #include <unistd.h>
 #endif
@@ -36,6 +37,13 @@
 #define NETLINK_DEFAULT_INPUT_BUFFER_SIZE 8192
 #define NETLINK_DEFAULT_OUTPUT_BUFFER_SIZE 8192
 
+//Writing to a closed connection should fail like any other send, not raise SIGPIPE
+#ifdef MSG_NOSIGNAL
+#define NETLINK_SEND_FLAGS MSG_NOSIGNAL
+#else
+#define NETLINK_SEND_FLAGS 0
+#endif
+
 namespace netLink {
 
     //! netLink Exceptions
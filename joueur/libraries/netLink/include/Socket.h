@@ -177,6 +177,11 @@ namespace netLink {
          Try to avoid using blocking mode. Use a SocketManager with listen(sec > 0.0) instead.
          */
         void setBlockingMode(bool blocking);
+        /*! Enables or disables Nagle's algorithm (only relevant for TCP)
+         TCP sockets are created with it disabled, so small messages are sent at once
+         @param active If true sends without delay else lets the system coalesce small packets
+         */
+        void setNoDelay(bool active);
         /*! Enables or disables the broadcasting (only relevant for sending)
          @param active If true enables broadcasting else disables broadcasting
          @pre Type needs to be UDP_PEER and IPv4
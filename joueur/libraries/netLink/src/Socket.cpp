@@ -290,6 +290,7 @@ void Socket::initAsTcpClient(const std::string& _hostRemote, unsigned _portRemot
     hostRemote = _hostRemote;
     portRemote = _portRemote;
     initSocket(waitUntilConnected);
+    setNoDelay(true);
 }
 
 void Socket::initAsTcpServer(const std::string& _hostLocal, unsigned _portLocal, unsigned _listenQueue) {
@@ -446,7 +447,7 @@ std::streamsize Socket::send(const char_type* buffer, std::streamsize size) {
         case TCP_SERVERS_CLIENT: {
             size_t sentBytes = 0;
             while(sentBytes < (size_t)size) {
-                int result = ::send(handle, (const char*)buffer + sentBytes, size - sentBytes, 0);
+                int result = ::send(handle, (const char*)buffer + sentBytes, size - sentBytes, NETLINK_SEND_FLAGS);
                 if(result <= 0) {
                     status = BUSY;
                     throw Exception(Exception::ERROR_SEND);
@@ -524,6 +525,19 @@ void Socket::setBlockingMode(bool blocking) {
         throw Exception(Exception::ERROR_IOCTL);
 }
 
+void Socket::setNoDelay(bool active) {
+    if(type != TCP_CLIENT && type != TCP_SERVERS_CLIENT)
+        throw Exception(Exception::BAD_PROTOCOL);
+
+    #ifdef WIN32
+    char flag = active;
+    #else
+    int flag = active;
+    #endif
+    if(setsockopt(handle, IPPROTO_TCP, TCP_NODELAY, &flag, sizeof(flag)) == -1)
+        throw Exception(Exception::ERROR_SET_SOCK_OPT);
+}
+
 void Socket::setBroadcast(bool active) {
     if(type != UDP_PEER || ipVersion != IPv4)
         throw Exception(Exception::BAD_PROTOCOL);
@@ -593,6 +607,7 @@ std::shared_ptr<Socket> Socket::accept() {
     client->portLocal = portLocal;
     readSockaddr(&remoteAddr, client->hostRemote, client->portRemote);
     client->setBlockingMode(false);
+    client->setNoDelay(true);
     clients.insert(client);
 
     return client;
@@ -11,10 +11,8 @@ namespace cpp_client
 
 Base_game::~Base_game() = default;
 
-std::string Base_game::get_alias(const char* name, const char* server, int port)
+std::string Base_game::get_alias(Connection& conn, const char* name)
 {
-   Connection conn;
-   conn.connect(server, port, false);
    std::string alias = R"({"event": "alias", "data": ")" + std::string(name) + "\"}";
    conn.send(alias);
    const auto resp = conn.recieve();
@@ -32,10 +30,8 @@ std::string Base_game::get_alias(const char* name, const char* server, int port)
 
 void Base_game::go()
 {
-   //grab the name first (do this again to ensure proper server-side name)
-   std::string alias = R"({"event": "alias", "data": ")" + get_game_name() + "\"}";
-   conn_.send(alias);
-   const auto game_name = handle_response("named")->as<std::string>();
+   //the alias was resolved on this connection, so the server already knows the game by this name
+   const auto game_name = get_game_name();
    //start with the same thing each time
    std::string to_send = R"({"event": "play", "data": {"clientType": "c++", "playerIndex": )";
    //now fill in the details
@@ -86,14 +82,45 @@ void Base_game::go()
    }
 }
 
+//size of the value arena before the first message
+static const std::size_t initial_arena_size = 64 * 1024;
+//what the parser's stack starts at, big enough that a delta doesn't make it grow
+static const std::size_t parse_stack_capacity = 16 * 1024;
+
+rapidjson::Document& Base_game::reset_document()
+{
+   //if the last message spilled out of the arena into extra chunks, grow it to fit
+   //a message that big; otherwise the arena is just emptied for reuse
+   if(doc_raw_ && value_pool_->Capacity() <= value_arena_.size())
+   {
+      value_pool_->Clear();
+      return *doc_raw_;
+   }
+   std::size_t size = initial_arena_size;
+   if(doc_raw_)
+   {
+      size = value_arena_.size();
+      while(size < 2 * value_pool_->Size())
+      {
+         size *= 2;
+      }
+   }
+   //the document points at the pool, and the pool at the arena, so tear down in that order
+   doc_raw_.reset();
+   value_pool_.reset();
+   value_arena_.resize(size);
+   value_pool_.reset(new rapidjson::MemoryPoolAllocator<>(value_arena_.data(), value_arena_.size()));
+   doc_raw_.reset(new rapidjson::Document(value_pool_.get(), parse_stack_capacity));
+   return *doc_raw_;
+}
+
 std::unique_ptr<Any> Base_game::handle_response(const std::string& expected)
 {
-   doc_raw_.reset(new rapidjson::Document);
-   //first get the response
-   resp_ = conn_.recieve();
-   //now parse it
-   auto& doc = *doc_raw_;
-   doc.Parse(resp_.c_str());
+   auto& doc = reset_document();
+   //first get the response (straight from the connection's buffer)
+   const auto resp = conn_.recieve_frame();
+   //now parse it in place; its strings point into the frame, which stays valid until the next recieve
+   doc.ParseInsitu(resp.data);
    const auto event = attr_wrapper::get_attribute<std::string>(doc, "event");
    //check if it matches the expected (if needed)
    if(event != "fatal" && expected != "" && event != expected)
@@ -118,6 +145,10 @@ std::unique_ptr<Any> Base_game::handle_response(const std::string& expected)
    else if(event == "delta")
    {
       apply_delta(doc, *this);
+      if(started_)
+      {
+         ai_->game_updated();
+      }
    }
    else if(event == "start")
    {
@@ -128,6 +159,7 @@ std::unique_ptr<Any> Base_game::handle_response(const std::string& expected)
       ai_->set_player(get_objects()[id]);
       std::cout << sgr::text_green << "Game is starting." << sgr::reset << '\n';
       ai_->start();
+      started_ = true;
    }
    else if(event == "over")
    {
@@ -8,6 +8,7 @@
 #include <string>
 #include <unordered_map>
 #include <string>
+#include <vector>
 #include "rapidjson/document.h"
 
 namespace cpp_client
@@ -27,10 +28,9 @@ public:
 
    virtual ~Base_game();
 
-   //Fetches an alias from the specified server
-   static std::string get_alias(const char* name,
-                                const char* server,
-                                int port);
+   //Fetches an alias over an open connection to the server
+   //the same connection can then be handed to the game with set_connection
+   static std::string get_alias(Connection& conn, const char* name);
 
    //sets if communication should be printed
    void set_print_communication(bool should_print) noexcept
@@ -38,6 +38,13 @@ public:
       conn_.set_print_communication(should_print);
    }
 
+   //play over a connection that is already open, such as the one the alias was fetched on
+   void set_connection(Connection conn, const std::string& server_url)
+   {
+      hostname_ = server_url;
+      conn_ = std::move(conn);
+   }
+
    //connect to the server on the specified port
    //will throw if an error occurs
    void connect(const char* server_url, unsigned port_num)
@@ -119,11 +126,20 @@ private:
    std::string game_settings_;
    std::string hostname_;
 
-   std::string resp_;
+   //messages are parsed in place, with their values kept in an arena that is
+   //reused for every message and only grows when one overflows it
+   std::vector<char> value_arena_;
+   std::unique_ptr<rapidjson::MemoryPoolAllocator<>> value_pool_;
    std::unique_ptr<rapidjson::Document> doc_raw_;
 
+   //empties the arena (growing it first if needed) and returns the document to parse into
+   rapidjson::Document& reset_document();
+
    //the AI object
    std::unique_ptr<Base_ai> ai_;
+
+   //whether the AI has been started (and can be told about updates)
+   bool started_ = false;
 };
 
 } // cpp_client
@@ -3,20 +3,62 @@
 #include "exceptions.hpp"
 #include "sgr.hpp"
 
-#include <array>
+#include <cerrno>
+#include <cstdint>
+#include <cstring>
 #include <iostream>
 #include <chrono>
-#include <thread>
+
+#ifndef WIN32
+   #include <poll.h>
+#endif // WIN32
 
 namespace cpp_client
 {
 
+//starting size of the recieve buffer; it doubles whenever a message does not fit
+static const std::size_t initial_buffer_size = 64 * 1024;
+
+//first bytes of a log written by Connection::record
+static const char record_magic[8] = {'J', 'O', 'U', 'E', 'U', 'R', 'L', '1'};
+
+//netLink keeps the socket's handle to itself, and its receive never blocks
+//(it only reads what is already buffered), so wait for data with poll
+class Pollable_socket : public netLink::Socket
+{
+public:
+   //block until there are bytes to read or the server hangs up
+   //throws a Communication_error if polling fails
+   void wait_readable()
+   {
+      #ifdef WIN32
+         WSAPOLLFD fd = {static_cast<SOCKET>(handle), POLLRDNORM, 0};
+         if(WSAPoll(&fd, 1, -1) < 0)
+         {
+            throw Communication_error("Error waiting on the socket.");
+         }
+      #else
+         pollfd fd = {handle, POLLIN, 0};
+         while(poll(&fd, 1, -1) < 0)
+         {
+            if(errno != EINTR)
+            {
+               throw Communication_error("Error waiting on the socket.");
+            }
+         }
+      #endif // WIN32
+   }
+};
+
 class Connection_internal
 {
 public:
    Connection_internal() :
       sock_(),
-      buffer_()
+      buffer_(initial_buffer_size),
+      begin_(0),
+      scanned_(0),
+      end_(0)
    {
       //need to do this for Windows
       #ifdef WIN32
@@ -53,33 +95,50 @@ public:
       }
    }
 
-   std::string recieve()
+   //the frame points into buffer_ and stays valid until the next recieve
+   Frame recieve()
    {
-      std::array<char, 2048> read_buffer;
-      std::string to_return;
-      to_return.reserve(read_buffer.size());
-      //put anything left over into the message to start
-      to_return += buffer_;
+      //the previous frame is done with, so its space can be reused: move any
+      //bytes already read past it (the start of the next message) to the front
+      if(begin_ > 0)
+      {
+         std::memmove(buffer_.data(), buffer_.data() + begin_, end_ - begin_);
+         end_ -= begin_;
+         scanned_ -= begin_;
+         begin_ = 0;
+      }
       try
       {
-         auto split_point = to_return.find('\x04');
-         while(split_point == std::string::npos)
+         //only bytes that have not been searched yet are scanned for the 0x04
+         const char* split_point = nullptr;
+         while(!(split_point = static_cast<const char*>(std::memchr(buffer_.data() + scanned_, '\x04', end_ - scanned_))))
          {
-            const auto recieved = sock_.receive(read_buffer.data(), read_buffer.size());
-            to_return.append(read_buffer.data(), recieved);
-            split_point = to_return.find('\x04');
-            // don't use 100% CPU [setting blocking mode didn't work properly]
-            std::this_thread::sleep_for(std::chrono::microseconds(100));
+            scanned_ = end_;
+            if(end_ == buffer_.size())
+            {
+               buffer_.resize(buffer_.size() * 2);
+            }
+            //sleep in the kernel until the server sends something
+            sock_.wait_readable();
+            const auto recieved = sock_.receive(buffer_.data() + end_, buffer_.size() - end_);
+            //readable with nothing to read means the server hung up
+            if(recieved == 0)
+            {
+               throw Communication_error("The server closed the connection.");
+            }
+            end_ += recieved;
          }
-         //now split by the 0x04
-         buffer_ = to_return.substr(split_point + 1);
-         to_return = to_return.substr(0, split_point);
+         //terminate the message in place, where the 0x04 was
+         const auto split = static_cast<std::size_t>(split_point - buffer_.data());
+         buffer_[split] = '\0';
+         begin_ = scanned_ = split + 1;
+         return Frame{buffer_.data(), split};
       }
       catch(const netLink::Exception& e)
       {
          convert_exception(e);
       }
-      return to_return;
+      return Frame{nullptr, 0};
    }
 
 private:
@@ -135,41 +194,93 @@ private:
       }
    }
 
-   netLink::Socket sock_;
-   std::string buffer_;
+   Pollable_socket sock_;
+   //bytes recieved; [0, begin_) is the last frame, [begin_, end_) is unread and
+   //[begin_, scanned_) is known to hold no 0x04; kept between messages
+   std::vector<char> buffer_;
+   std::size_t begin_;
+   std::size_t scanned_;
+   std::size_t end_;
 };
 
-std::string Connection::recieve()
+Frame Connection::recieve_frame()
 {
-   auto msg = conn_->recieve();
+   Frame msg;
+   if(replay_)
+   {
+      //skip what the client sent when recording; only what it recieved is replayed
+      unsigned char header[13];
+      do
+      {
+         if(!replay_->read(reinterpret_cast<char*>(header), sizeof(header)))
+         {
+            throw Communication_error("End of the replay log.");
+         }
+         std::uint32_t length = 0;
+         for(auto i = 0; i < 4; ++i)
+         {
+            length |= static_cast<std::uint32_t>(header[9 + i]) << (8 * i);
+         }
+         replay_buffer_.resize(length + 1);
+         if(!replay_->read(replay_buffer_.data(), length))
+         {
+            throw Communication_error("Replay log ends in the middle of a message.");
+         }
+         replay_buffer_[length] = '\0';
+         msg = Frame{replay_buffer_.data(), length};
+      } while(header[0] != 0);
+   }
+   else
+   {
+      msg = conn_->recieve();
+   }
+   log_message(false, msg.data, msg.size);
    if(print_communication_)
    {
-      std::cout << sgr::text_magenta << "FROM SERVER <-- " << msg << sgr::reset << '\n';
+      std::cout << sgr::text_magenta << "FROM SERVER <-- " << msg.data << sgr::reset << '\n';
    }
    return msg;
 }
 
+std::string Connection::recieve()
+{
+   const auto msg = recieve_frame();
+   return std::string(msg.data, msg.size);
+}
+
 void Connection::send(const std::string& msg)
 {
    using namespace std::chrono;
    const auto time = duration_cast<milliseconds>(system_clock::now().time_since_epoch()).count();
+   //cut out the last } and append the time sent, building the whole frame in
+   //one reused buffer so it goes out in a single write
+   send_buffer_.assign(msg, 0, msg.size() - 1);
+   send_buffer_ += R"(, "sentTime": )";
+   send_buffer_ += std::to_string(time);
+   send_buffer_ += '}';
    if(print_communication_)
    {
       std::cout << sgr::text_magenta
                 << "TO SERVER --> "
-                << msg.substr(0, msg.size() - 1)
-                << ", \"sentTime\": "
-                << time << "}"
+                << send_buffer_
                 << sgr::reset
                 << '\n';
    }
-   //cut out the last } and append the time sent
-   conn_->send(msg.substr(0, msg.size() - 1));
-   conn_->send(R"(, "sentTime": )" + std::to_string(time) + "}\x04");
+   log_message(true, send_buffer_.data(), send_buffer_.size());
+   if(replay_)
+   {
+      return;
+   }
+   send_buffer_ += '\x04';
+   conn_->send(send_buffer_);
 }
 
 void Connection::connect(const char* host, unsigned port, bool print)
 {
+   if(replay_)
+   {
+      return;
+   }
    if(print)
    {
       std::cout << sgr::text_cyan << "Connecting to: " << host << ":" << port << '\n' << sgr::reset;
@@ -177,6 +288,55 @@ void Connection::connect(const char* host, unsigned port, bool print)
    conn_->connect(host, port);
 }
 
+void Connection::record(const std::string& path)
+{
+   record_.reset(new std::ofstream(path, std::ios::binary));
+   if(!*record_)
+   {
+      record_.reset();
+      throw Communication_error("Could not open " + path + " to record to.");
+   }
+   record_->write(record_magic, sizeof(record_magic));
+   record_start_ = std::chrono::steady_clock::now();
+}
+
+void Connection::replay(const std::string& path)
+{
+   replay_.reset(new std::ifstream(path, std::ios::binary));
+   char magic[sizeof(record_magic)];
+   if(!replay_->read(magic, sizeof(magic)) || std::memcmp(magic, record_magic, sizeof(magic)) != 0)
+   {
+      replay_.reset();
+      throw Communication_error("Could not open " + path + " as a recorded log.");
+   }
+   std::cout << sgr::text_cyan << "Replaying: " << path << '\n' << sgr::reset;
+}
+
+void Connection::log_message(bool sent, const char* msg, std::size_t size)
+{
+   if(!record_)
+   {
+      return;
+   }
+   using namespace std::chrono;
+   const std::uint64_t time = duration_cast<nanoseconds>(steady_clock::now() - record_start_).count();
+   const std::uint32_t length = size;
+   unsigned char header[13];
+   header[0] = sent;
+   for(auto i = 0; i < 8; ++i)
+   {
+      header[1 + i] = static_cast<unsigned char>(time >> (8 * i));
+   }
+   for(auto i = 0; i < 4; ++i)
+   {
+      header[9 + i] = static_cast<unsigned char>(length >> (8 * i));
+   }
+   record_->write(reinterpret_cast<const char*>(header), sizeof(header));
+   record_->write(msg, size);
+   //the client exits as soon as the game is over, so keep the log complete
+   record_->flush();
+}
+
 Connection::Connection(bool print_communication) :
    conn_(new Connection_internal),
    print_communication_(print_communication) {}
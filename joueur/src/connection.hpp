@@ -1,12 +1,24 @@
 #ifndef CONNECTION_HPP
 #define CONNECTION_HPP
 
+#include <chrono>
+#include <fstream>
 #include <memory>
 #include <string>
+#include <vector>
 
 namespace cpp_client
 {
 
+//a recieved message, in place in the connection's buffer
+//data is null terminated (where the 0x04 was) and may be modified or parsed in place
+//it is only valid until the next recieve
+struct Frame
+{
+   char* data;
+   std::size_t size;
+};
+
 //customization point (in the .cpp)
 class Connection_internal;
 
@@ -37,15 +49,41 @@ public:
    //throws a Communication_error if it fails
    std::string recieve();
 
+   //recieve a message without copying it out of the connection's buffer
+   //throws a Communication_error if it fails
+   Frame recieve_frame();
+
    //changes if communication should be printed or not
    void set_print_communication(bool should_print) noexcept
    {
       print_communication_ = should_print;
    }
 
+   //write every message sent and recieved to a binary log at path
+   //after an 8 byte header, each record is a direction byte (0 recieved, 1 sent), the nanoseconds
+   //since recording began (8 bytes) and the message length (4 bytes), all
+   //little-endian, followed by the message without its terminator
+   //throws a Communication_error if the file can not be opened
+   void record(const std::string& path);
+
+   //recieve messages from a log written by record instead of the socket
+   //messages sent are dropped and connect does nothing, so the client runs
+   //deterministically against the recorded traffic as fast as it can
+   //throws a Communication_error if the file can not be opened
+   void replay(const std::string& path);
+
 private:
+   //append a message to the record log, if recording
+   void log_message(bool sent, const char* msg, std::size_t size);
+
    std::unique_ptr<Connection_internal> conn_;
    bool print_communication_;
+   //the frame being sent; kept so its memory is reused
+   std::string send_buffer_;
+   std::unique_ptr<std::ofstream> record_;
+   std::unique_ptr<std::ifstream> replay_;
+   std::vector<char> replay_buffer_;
+   std::chrono::steady_clock::time_point record_start_;
 };
 
 } // cpp_client
@@ -70,6 +70,22 @@ int main(int argc, const char* argv[])
             false,
             "",
             "string"
+         },
+         {
+            "",
+            "record",
+            "(debugging) Record the game's traffic, with timestamps, to a binary log.",
+            false,
+            "",
+            "file"
+         },
+         {
+            "",
+            "replay",
+            "(debugging) Play against a log written by --record instead of a server.",
+            false,
+            "",
+            "file"
          }
       };
       //enum for accessing string options
@@ -80,7 +96,9 @@ int main(int argc, const char* argv[])
          password,
          settings,
          session,
-         ai_settings
+         ai_settings,
+         record,
+         replay
       };
       TCLAP::ValueArg<int> int_args[] =
       {
@@ -134,14 +152,22 @@ int main(int argc, const char* argv[])
          port_num = std::stoi(server_str.substr(colon_loc + 1));
          server_str = server_str.substr(0, colon_loc);
       }
+      //one connection resolves the game's alias and then plays it
+      Connection conn(print_io.getValue());
+      if(!string_args[record].getValue().empty())
+      {
+         conn.record(string_args[record].getValue());
+      }
+      if(!string_args[replay].getValue().empty())
+      {
+         conn.replay(string_args[replay].getValue());
+      }
+      conn.connect(server_str.c_str(), port_num);
       //retrieve the game (use server aliases)
-      const auto game_name = Base_game::get_alias(game_arg.getValue().c_str(),
-                                                  server_str.c_str(),
-                                                  port_num);
+      const auto game_name = Base_game::get_alias(conn, game_arg.getValue().c_str());
       auto& game = Game_registry::get_game(game_name);
       //set up some stuff for the game
-      game.set_print_communication(print_io.getValue());
-      game.connect(server_str.c_str(), port_num);
+      game.set_connection(std::move(conn), server_str);
       game.set_player_index(int_args[player_index].getValue());
       game.set_password(string_args[password].getValue());
       game.set_session(string_args[session].getValue());